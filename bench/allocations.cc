@@ -0,0 +1,137 @@
+//*************************************************************************
+// File allocations.cc
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// cex Library heap allocations per request benchmark
+//*************************************************************************
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <httplib.h>
+#include <cex.hpp>
+
+//***************************************************************************
+// allocation counter (operator new of all threads of the server process.
+// libevent/libevhtp allocate with malloc() and are not counted)
+//***************************************************************************
+
+static std::atomic<long> allocations(0);
+
+void* operator new(size_t size)
+{
+   allocations++;
+
+   void* p= malloc(size ? size : 1);
+
+   if (!p)
+      throw std::bad_alloc();
+
+   return p;
+}
+
+void operator delete(void* p) noexcept
+{
+   free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+   free(p);
+}
+
+//***************************************************************************
+// client (load generator, separate process so its allocations are not counted)
+//***************************************************************************
+
+static int client(const char* host, int port, int count)
+{
+   httplib::Client cli(host, port);
+   int ok= 0;
+
+   for (int i= 0; i < count; i++)
+   {
+      auto res= cli.Get("/alloc?name=john&note=coder");
+
+      if (!res)
+      {
+         // server not up yet
+
+         std::this_thread::sleep_for(std::chrono::milliseconds(10));
+         i--;
+         continue;
+      }
+
+      if (res->status == 200)
+         ok++;
+   }
+
+   return ok == count ? 0 : 1;
+}
+
+//***************************************************************************
+// main
+//***************************************************************************
+
+int main(int argc, char* argv[])
+{
+   // usage: bench_allocations [requests]
+   // allocations are measured after a warmup phase, so pooled objects already exist
+
+   const char* host= "127.0.0.1";
+   int port= 16555;
+   int count= argc > 1 ? atoi(argv[1]) : 10000;
+   int warmup= count / 10;
+   long before= 0, after= 0;
+   std::atomic<int> requests(0);
+
+   // fork before any threads are started
+
+   pid_t pid= fork();
+
+   if (pid < 0)
+      return 1;
+
+   if (!pid)
+      return client(host, port, warmup + count);
+
+   cex::Server app;
+
+   app.get("/alloc", [&](cex::Request* req, cex::Response* res, cex::Next next)
+   {
+      int n= ++requests;
+
+      if (n == warmup + 1)
+         before= allocations;
+      else if (n == warmup + count)
+         after= allocations;
+
+      res->set("Content-Type", "text/plain");
+      res->end("ok", 200);
+   });
+
+   app.listen(host, port, false /* don't block */);
+
+   int status= 0;
+   waitpid(pid, &status, 0);
+
+   app.stop();
+
+   printf("requests:             %d\n", count);
+   printf("allocations:          %ld\n", after - before);
+   printf("allocations/request:  %.2f\n", count > 1 ? (double)(after - before) / (count - 1) : 0.0);
+
+   return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
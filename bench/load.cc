@@ -0,0 +1,417 @@
+//*************************************************************************
+// File load.cc
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// cex Library load generator (keep-alive clients, latency percentiles)
+//*************************************************************************
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cex.hpp>
+
+//***************************************************************************
+// definitions
+//***************************************************************************
+
+typedef std::chrono::steady_clock Clock;
+
+static const char* host= "127.0.0.1";
+static int port= 16555;
+
+struct Scenario
+{
+   const char* name;
+   const char* path;
+   const char* headers;                     // additional request headers
+   std::function<void(cex::Server& app)> setup;
+};
+
+struct Result
+{
+   Result() : requests(0), errors(0) {}
+
+   long requests;
+   long errors;
+   std::vector<unsigned int> latencies;     // microseconds
+};
+
+//***************************************************************************
+// class Connection (blocking keep-alive HTTP/1.1 client)
+//***************************************************************************
+
+class Connection
+{
+   public:
+
+      Connection() : fd(-1) {}
+      ~Connection() { close(); }
+
+      bool open()
+      {
+         struct sockaddr_in addr;
+         int one= 1;
+
+         close();
+
+         memset(&addr, 0, sizeof(addr));
+         addr.sin_family= AF_INET;
+         addr.sin_port= htons(port);
+         inet_pton(AF_INET, host, &addr.sin_addr);
+
+         fd= socket(AF_INET, SOCK_STREAM, 0);
+
+         if (fd < 0)
+            return false;
+
+         setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+         if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)))
+         {
+            close();
+            return false;
+         }
+
+         return true;
+      }
+
+      void close()
+      {
+         if (fd >= 0)
+            ::close(fd);
+
+         fd= -1;
+         buf.clear();
+      }
+
+      /* sends the request and reads the whole response. returns the HTTP status, or -1 on failure */
+
+      int request(const std::string& req)
+      {
+         if (fd < 0 && !open())
+            return -1;
+
+         for (size_t sent= 0; sent < req.size(); )
+         {
+            ssize_t n= ::write(fd, req.data() + sent, req.size() - sent);
+
+            if (n <= 0)
+               return fail();
+
+            sent+= n;
+         }
+
+         size_t headerEnd;
+
+         while ((headerEnd= buf.find("\r\n\r\n")) == std::string::npos)
+         {
+            if (!fill())
+               return fail();
+         }
+
+         if (buf.compare(0, 5, "HTTP/") || buf.size() < 12)
+            return fail();
+
+         int status= atoi(buf.c_str() + 9);
+         std::string header(buf, 0, headerEnd + 2);
+
+         std::transform(header.begin(), header.end(), header.begin(), ::tolower);
+
+         bool keepAlive= header.find("\r\nconnection: close") == std::string::npos;
+         size_t pos= headerEnd + 4;
+         size_t lengthPos= header.find("\r\ncontent-length:");
+
+         if (header.find("\r\ntransfer-encoding: chunked") != std::string::npos)
+         {
+            // chunk size lines, up to the last (empty) chunk and its trailing CRLF
+
+            while (true)
+            {
+               size_t lineEnd;
+
+               while ((lineEnd= buf.find("\r\n", pos)) == std::string::npos)
+               {
+                  if (!fill())
+                     return fail();
+               }
+
+               size_t chunkSize= strtoul(buf.c_str() + pos, 0, 16);
+
+               pos= lineEnd + 2 + chunkSize + 2;
+
+               while (buf.size() < pos)
+               {
+                  if (!fill())
+                     return fail();
+               }
+
+               if (!chunkSize)
+                  break;
+            }
+         }
+         else if (lengthPos != std::string::npos)
+         {
+            pos+= strtoul(header.c_str() + lengthPos + 17, 0, 10);
+
+            while (buf.size() < pos)
+            {
+               if (!fill())
+                  return fail();
+            }
+         }
+
+         buf.erase(0, pos);
+
+         if (!keepAlive)
+            close();
+
+         return status;
+      }
+
+   private:
+
+      bool fill()
+      {
+         char tmp[16384];
+         ssize_t n= ::read(fd, tmp, sizeof(tmp));
+
+         if (n <= 0)
+            return false;
+
+         buf.append(tmp, n);
+         return true;
+      }
+
+      int fail()
+      {
+         close();
+         return -1;
+      }
+
+      int fd;
+      std::string buf;
+};
+
+//***************************************************************************
+// percentile (of sorted latencies)
+//***************************************************************************
+
+static unsigned int percentile(const std::vector<unsigned int>& sorted, double p)
+{
+   if (sorted.empty())
+      return 0;
+
+   size_t index= (size_t)(p * (sorted.size() - 1) + 0.5);
+
+   return sorted[std::min(index, sorted.size() - 1)];
+}
+
+//***************************************************************************
+// run (one scenario: warmup, then measure for `seconds` with `connections` clients)
+//***************************************************************************
+
+static void run(const Scenario& scenario, int seconds, int connections, int serverThreads)
+{
+   cex::Server::Config config;
+   config.threadCount= serverThreads;
+
+   cex::Server app(config);
+   std::atomic<int> phase(0);      // 0: warmup, 1: measuring, 2: stop
+   std::vector<Result> results(connections);
+   std::vector<std::thread> threads;
+
+   scenario.setup(app);
+   app.listen(host, ++port, false /* don't block */);
+
+   std::string req= std::string("GET ") + scenario.path + " HTTP/1.1\r\nHost: " + host + "\r\n" + scenario.headers + "\r\n";
+
+   for (int i= 0; i < connections; i++)
+   {
+      threads.push_back(std::thread([&phase, &req](Result* result)
+      {
+         Connection conn;
+
+         result->latencies.reserve(1 << 20);
+
+         while (phase < 2)
+         {
+            Clock::time_point begin= Clock::now();
+            int status= conn.request(req);
+            Clock::time_point end= Clock::now();
+
+            if (phase != 1)
+               continue;
+
+            if (status != 200)
+            {
+               result->errors++;
+               continue;
+            }
+
+            result->requests++;
+            result->latencies.push_back((unsigned int)std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count());
+         }
+      }, &results[i]));
+   }
+
+   std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+   phase= 1;
+   Clock::time_point begin= Clock::now();
+
+   std::this_thread::sleep_for(std::chrono::seconds(seconds));
+
+   phase= 2;
+   std::chrono::duration<double> elapsed= Clock::now() - begin;
+
+   for (size_t i= 0; i < threads.size(); i++)
+      threads[i].join();
+
+   app.stop();
+
+   // merge the samples of all clients
+
+   Result total;
+
+   for (size_t i= 0; i < results.size(); i++)
+   {
+      total.requests+= results[i].requests;
+      total.errors+= results[i].errors;
+      total.latencies.insert(total.latencies.end(), results[i].latencies.begin(), results[i].latencies.end());
+   }
+
+   std::sort(total.latencies.begin(), total.latencies.end());
+
+   printf("%-12s %12.0f %10u %10u %10u %8ld\n", scenario.name, total.requests / elapsed.count(),
+      percentile(total.latencies, 0.5), percentile(total.latencies, 0.99), percentile(total.latencies, 0.999), total.errors);
+}
+
+//***************************************************************************
+// main
+//***************************************************************************
+
+int main(int argc, char* argv[])
+{
+   // usage: bench_load [seconds per scenario] [connections] [server threads]
+
+   int seconds= argc > 1 ? atoi(argv[1]) : 5;
+   int connections= argc > 2 ? atoi(argv[2]) : 16;
+   int serverThreads= argc > 3 ? atoi(argv[3]) : 4;
+
+   // response bodies and a file for the sendfile scenario
+
+   std::string json("[");
+
+   for (int i= 0; json.size() < 16*1024; i++)
+      json+= (i ? "," : "") + std::string("{\"id\":") + std::to_string(i) + ",\"name\":\"user " + std::to_string(i*7919 % 1000) + "\"}";
+
+   json+= "]";
+
+   char fileName[]= "/tmp/cex_bench_load_XXXXXX";
+   int fileFd= mkstemp(fileName);
+   size_t fileSize= 64*1024;
+
+   if (fileFd < 0)
+      return 1;
+
+   std::string fileData(fileSize, 'x');
+
+   if (write(fileFd, fileData.data(), fileSize) != (ssize_t)fileSize)
+      return 1;
+
+   ::close(fileFd);
+
+   Scenario scenarios[]=
+   {
+      { "hello", "/hello", "", [](cex::Server& app)
+      {
+         app.get("/hello", [](cex::Request* req, cex::Response* res, cex::Next next)
+         {
+            res->set("Content-Type", "text/plain");
+            res->end("hello", 200);
+         }, cex::Middleware::fMatchCompare);
+      }},
+
+      // the request matches the last of 200 routes with path parameters
+
+      { "routes", "/api/v1/resource199/42", "", [](cex::Server& app)
+      {
+         for (int i= 0; i < 200; i++)
+         {
+            std::string path= "/api/v1/resource" + std::to_string(i) + "/:id";
+
+            app.get(path.c_str(), [](cex::Request* req, cex::Response* res, cex::Next next)
+            {
+               cex::StringView id= req->getParam("id");
+               res->end(id.data(), id.size(), 200);
+            });
+         }
+      }},
+
+      { "json-gzip", "/json", "Accept-Encoding: gzip\r\n", [&json](cex::Server& app)
+      {
+         app.get("/json", [&json](cex::Request* req, cex::Response* res, cex::Next next)
+         {
+            res->set("Content-Type", "application/json");
+            res->end(json.data(), json.size(), 200);
+         }, cex::Middleware::fMatchCompare);
+      }},
+
+      { "sendfile", "/file", "", [&fileName, fileSize](cex::Server& app)
+      {
+         app.get("/file", [&fileName, fileSize](cex::Request* req, cex::Response* res, cex::Next next)
+         {
+            res->set("Content-Type", "application/octet-stream");
+            res->sendFile(200, open(fileName, O_RDONLY), 0, fileSize);
+         }, cex::Middleware::fMatchCompare);
+      }},
+
+      // CPU-bound handler on the offload pool
+
+      { "offload", "/hash", "", [](cex::Server& app)
+      {
+         app.get("/hash", [](cex::Request* req, cex::Response* res, cex::Next next)
+         {
+            unsigned long hash= 5381;
+
+            for (int i= 0; i < 100000; i++)
+               hash= hash * 33 + (i & 0xff);
+
+            std::string body= std::to_string(hash);
+            res->end(body.c_str(), body.size(), 200);
+         }, cex::Middleware::fMatchCompare | cex::Middleware::fOffload);
+      }}
+   };
+
+   cex::Server::libraryInit();
+
+   printf("%d connections, %d server threads, %d seconds per scenario\n\n", connections, serverThreads, seconds);
+   printf("%-12s %12s %10s %10s %10s %8s\n", "scenario", "requests/s", "p50 [us]", "p99 [us]", "p999 [us]", "errors");
+
+   for (size_t i= 0; i < sizeof(scenarios)/sizeof(scenarios[0]); i++)
+      run(scenarios[i], seconds, connections, serverThreads);
+
+   unlink(fileName);
+
+   return 0;
+}
@@ -0,0 +1,133 @@
+//*************************************************************************
+// File middleware_chain.cc
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// cex Library middleware chain benchmark
+//*************************************************************************
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <httplib.h>
+#include <cex.hpp>
+
+//***************************************************************************
+// definitions
+//***************************************************************************
+
+static const char* host= "127.0.0.1";
+static int port= 16555;
+
+enum Scenario
+{
+   scRoutes,    // N-1 path middlewares which don't match, one global middleware replying
+   scNext,      // N global middlewares, each calling next(), the last one replying
+
+   nScenarios
+};
+
+static const char* scenarioNames[nScenarios]= { "routes", "next" };
+
+//***************************************************************************
+// run (one scenario with `count` middlewares)
+//***************************************************************************
+
+static double run(int scenario, int count, int seconds, int clients)
+{
+   cex::Server app;
+   std::atomic<long> requests(0);
+   std::atomic<bool> stop(false);
+   std::vector<std::thread> threads;
+
+   for (int i= 0; i < count-1; i++)
+   {
+      if (scenario == scRoutes)
+      {
+         std::string path= "/route/" + std::to_string(i);
+
+         app.get(path.c_str(), [](cex::Request* req, cex::Response* res, cex::Next next)
+         {
+            res->end(500);
+         }, cex::Middleware::fMatchCompare);
+      }
+      else
+      {
+         app.use([](cex::Request* req, cex::Response* res, cex::Next next)
+         {
+            next();
+         });
+      }
+   }
+
+   app.use([](cex::Request* req, cex::Response* res, cex::Next next)
+   {
+      res->end("ok", 200);
+   });
+
+   app.listen(host, ++port, false /* don't block */);
+
+   std::chrono::steady_clock::time_point begin= std::chrono::steady_clock::now();
+
+   for (int i= 0; i < clients; i++)
+   {
+      threads.push_back(std::thread([&requests, &stop]()
+      {
+         httplib::Client cli(host, port);
+
+         while (!stop)
+         {
+            auto res= cli.Get("/bench");
+
+            if (res && res->status == 200)
+               requests++;
+         }
+      }));
+   }
+
+   std::this_thread::sleep_for(std::chrono::seconds(seconds));
+   stop= true;
+
+   for (size_t i= 0; i < threads.size(); i++)
+      threads[i].join();
+
+   std::chrono::duration<double> elapsed= std::chrono::steady_clock::now() - begin;
+
+   app.stop();
+
+   return requests / elapsed.count();
+}
+
+//***************************************************************************
+// main
+//***************************************************************************
+
+int main(int argc, char* argv[])
+{
+   // usage: bench_middleware_chain [seconds per run] [client threads]
+
+   int seconds= argc > 1 ? atoi(argv[1]) : 3;
+   int clients= argc > 2 ? atoi(argv[2]) : 4;
+   int counts[]= { 10, 100, 1000 };
+
+   cex::Server::libraryInit();
+
+   printf("%-10s %12s %14s\n", "scenario", "middlewares", "requests/sec");
+
+   for (int scenario= 0; scenario < nScenarios; scenario++)
+   {
+      for (size_t i= 0; i < sizeof(counts)/sizeof(counts[0]); i++)
+         printf("%-10s %12d %14.0f\n", scenarioNames[scenario], counts[i], run(scenario, counts[i], seconds, clients));
+   }
+
+   return 0;
+}
@@ -0,0 +1,136 @@
+//*************************************************************************
+// File static_files.cc
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// cex Library static file serving benchmark (ifstream vs. sendfile)
+//*************************************************************************
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include <httplib.h>
+#include <cex.hpp>
+#include <cex/filesystem.hpp>
+
+//***************************************************************************
+// definitions
+//***************************************************************************
+
+static const char* host= "127.0.0.1";
+static int port= 16555;
+
+//***************************************************************************
+// run (GET `url` for `seconds` with `clients` threads, returns MB/s)
+//***************************************************************************
+
+static double run(const char* url, size_t fileSize, int seconds, int clients)
+{
+   std::atomic<long> bytes(0);
+   std::atomic<bool> stop(false);
+   std::vector<std::thread> threads;
+
+   std::chrono::steady_clock::time_point begin= std::chrono::steady_clock::now();
+
+   for (int i= 0; i < clients; i++)
+   {
+      threads.push_back(std::thread([&bytes, &stop, url, fileSize]()
+      {
+         httplib::Client cli(host, port);
+
+         while (!stop)
+         {
+            auto res= cli.Get(url);
+
+            if (res && res->status == 200 && res->body.size() == fileSize)
+               bytes += res->body.size();
+         }
+      }));
+   }
+
+   std::this_thread::sleep_for(std::chrono::seconds(seconds));
+   stop= true;
+
+   for (size_t i= 0; i < threads.size(); i++)
+      threads[i].join();
+
+   std::chrono::duration<double> elapsed= std::chrono::steady_clock::now() - begin;
+
+   return bytes / elapsed.count() / (1024.0*1024.0);
+}
+
+//***************************************************************************
+// main
+//***************************************************************************
+
+int main(int argc, char* argv[])
+{
+   // usage: bench_static_files [file size in MB] [seconds per run] [client threads]
+
+   size_t fileSize= (argc > 1 ? atoi(argv[1]) : 64) * 1024 * 1024;
+   int seconds= argc > 2 ? atoi(argv[2]) : 3;
+   int clients= argc > 3 ? atoi(argv[3]) : 4;
+   char dir[]= "/tmp/cex_bench_XXXXXX";
+
+   if (!mkdtemp(dir))
+      return 1;
+
+   std::string path= std::string(dir) + "/large.bin";
+
+   {
+      std::ofstream out(path.c_str(), std::ios::out|std::ios::binary);
+      std::vector<char> block(1024*1024);
+
+      for (size_t i= 0; i < block.size(); i++)
+         block[i]= (char)i;
+
+      for (size_t written= 0; written < fileSize; written += block.size())
+         out.write(block.data(), block.size());
+   }
+
+   cex::Server::libraryInit();
+
+   cex::Server app;
+
+   // old path: ifstream + chunked stream (each byte is copied through user space)
+
+   app.get("/ifstream", [&path](cex::Request* req, cex::Response* res, cex::Next next)
+   {
+      std::ifstream file(path.c_str(), std::ios::in|std::ios::binary);
+
+      res->set("Content-Type", "application/octet-stream");
+      res->stream(200, &file);
+   });
+
+   // filesystem middleware (sendfile)
+
+   std::shared_ptr<cex::FilesystemOptions> opts(new cex::FilesystemOptions());
+   opts.get()->rootPath= dir;
+
+   app.use("/sendfile", cex::filesystem(opts));
+
+   app.listen(host, port, false /* don't block */);
+
+   printf("%-10s %10s %10s\n", "path", "file (MB)", "MB/sec");
+   printf("%-10s %10zu %10.0f\n", "ifstream", fileSize / (1024*1024), run("/ifstream", fileSize, seconds, clients));
+   printf("%-10s %10zu %10.0f\n", "sendfile", fileSize / (1024*1024), run("/sendfile/large.bin", fileSize, seconds, clients));
+
+   app.stop();
+
+   unlink(path.c_str());
+   rmdir(dir);
+
+   return 0;
+}
@@ -0,0 +1,18 @@
+# - Try to find the brotli encoder library
+# Once done this will define
+#
+# LIBBROTLI_FOUND - System has brotli
+# LIBBROTLI_INCLUDE_DIR - the brotli include directory
+# LIBBROTLI_LIBRARIES - The libraries needed to use the brotli encoder
+
+find_path     (LIBBROTLI_INCLUDE_DIR    NAMES brotli/encode.h)
+find_library  (LIBBROTLI_ENC_LIBRARY    NAMES brotlienc)
+find_library  (LIBBROTLI_COMMON_LIBRARY NAMES brotlicommon)
+
+include (FindPackageHandleStandardArgs)
+
+set (LIBBROTLI_INCLUDE_DIRS ${LIBBROTLI_INCLUDE_DIR})
+set (LIBBROTLI_LIBRARIES ${LIBBROTLI_ENC_LIBRARY} ${LIBBROTLI_COMMON_LIBRARY})
+
+find_package_handle_standard_args (LIBBROTLI DEFAULT_MSG LIBBROTLI_ENC_LIBRARY LIBBROTLI_COMMON_LIBRARY LIBBROTLI_INCLUDE_DIR)
+mark_as_advanced(LIBBROTLI_INCLUDE_DIRS LIBBROTLI_LIBRARIES)
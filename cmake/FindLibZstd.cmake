@@ -0,0 +1,17 @@
+# - Try to find the zstd compression library
+# Once done this will define
+#
+# LIBZSTD_FOUND - System has zstd
+# LIBZSTD_INCLUDE_DIR - the zstd include directory
+# LIBZSTD_LIBRARIES - The libraries needed to use zstd
+
+find_path     (LIBZSTD_INCLUDE_DIR NAMES zstd.h)
+find_library  (LIBZSTD_LIBRARY     NAMES zstd)
+
+include (FindPackageHandleStandardArgs)
+
+set (LIBZSTD_INCLUDE_DIRS ${LIBZSTD_INCLUDE_DIR})
+set (LIBZSTD_LIBRARIES ${LIBZSTD_LIBRARY})
+
+find_package_handle_standard_args (LIBZSTD DEFAULT_MSG LIBZSTD_LIBRARIES LIBZSTD_INCLUDE_DIR)
+mark_as_advanced(LIBZSTD_INCLUDE_DIRS LIBZSTD_LIBRARIES)
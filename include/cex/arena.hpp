@@ -0,0 +1,157 @@
+//*************************************************************************
+// File arena.hpp
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// Class Arena
+//*************************************************************************
+
+#ifndef __ARENA_HPP__
+#define __ARENA_HPP__
+
+/*! \file arena.hpp
+  \brief Bump-pointer arena allocator, used for per-request allocations
+*/
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <string>
+#include <vector>
+
+#define CEX_ARENA_BLOCK_SIZE 4096   // size of a regular arena block
+#define CEX_ARENA_ALIGN (2*sizeof(void*))
+
+namespace cex
+{
+
+//***************************************************************************
+// class Arena
+//***************************************************************************
+/*! \class Arena
+  \brief Bump-pointer allocator which frees all of its memory at once.
+
+  Memory is handed out from blocks of CEX_ARENA_BLOCK_SIZE bytes, so most allocations are just a pointer
+  increment. Single allocations cannot be freed; the whole arena is released with reset() (which keeps the
+  first block for reuse) or when the arena is destroyed. Destructors of objects placed in the arena are
+  never called, so it should only hold trivially destructible data, or containers using ArenaAllocator.
+
+  Each Request owns an arena, which is reset when the request is finished:
+
+  ```
+   app.use([](cex::Request* req, cex::Response* res, std::function<void()> next)
+   {
+      char* agent= req->arena().strdup(req->get("User-Agent"));
+      cex::ArenaVector<int> ids(req->arena());
+      ...
+   });
+  ```
+  */
+
+class Arena
+{
+   public:
+
+      Arena() : blocks(nullptr), first(nullptr), ptr(nullptr), end(nullptr) {}
+      ~Arena();
+
+      Arena(const Arena&)= delete;
+      Arena& operator=(const Arena&)= delete;
+
+      /*! \brief Allocates `size` bytes aligned to `align` (must be a power of 2). Throws `std::bad_alloc` on failure. */
+      void* alloc(size_t size, size_t align= CEX_ARENA_ALIGN)
+      {
+         char* p= (char*)(((uintptr_t)ptr + align-1) & ~(uintptr_t)(align-1));
+
+         if (!ptr || p > end || size > (size_t)(end - p))
+            return grow(size, align);
+
+         ptr= p + size;
+         return p;
+      }
+
+      /*! \brief Copies a null-terminated string into the arena. Returns `nullptr` if `str` is `nullptr`. */
+      char* strdup(const char* str);
+
+      /*! \brief Copies `len` bytes of `str` into the arena and null-terminates the copy */
+      char* strndup(const char* str, size_t len);
+
+      /*! \brief Releases all allocations. The first block is kept for reuse. */
+      void reset();
+
+   private:
+
+      struct Block
+      {
+         Block* next;
+         size_t size;   // usable bytes following the header
+      };
+
+      void* grow(size_t size, size_t align);
+
+      static char* data(Block* block) { return (char*)(block + 1); }
+
+      Block* blocks;    // all blocks, the current one first
+      Block* first;     // first regular block (kept by reset)
+      char* ptr;        // free space of the current block
+      char* end;
+};
+
+//***************************************************************************
+// class ArenaAllocator
+//***************************************************************************
+/*! \class ArenaAllocator
+  \brief Standard allocator which takes its memory from an Arena (`deallocate` is a no-op). */
+
+template<typename T>
+class ArenaAllocator
+{
+   public:
+
+      typedef T value_type;
+      typedef T* pointer;
+      typedef const T* const_pointer;
+      typedef T& reference;
+      typedef const T& const_reference;
+      typedef size_t size_type;
+      typedef ptrdiff_t difference_type;
+
+      template<typename U> struct rebind { typedef ArenaAllocator<U> other; };
+
+      ArenaAllocator() : arena(nullptr) {}    // unbound, can't allocate (needed by some std::string implementations)
+      ArenaAllocator(Arena& arena) : arena(&arena) {}
+      template<typename U> ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+      T* allocate(size_t n)
+      {
+         if (!arena)
+            throw std::bad_alloc();
+
+         // at least default alignment: some std::string implementations place a header into the char buffer
+
+         return (T*)arena->alloc(n * sizeof(T), alignof(T) > CEX_ARENA_ALIGN ? alignof(T) : CEX_ARENA_ALIGN);
+      }
+
+      void deallocate(T*, size_t) {}
+      size_t max_size() const { return (size_t)-1 / sizeof(T); }
+
+      template<typename U> bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+      template<typename U> bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+      Arena* arena;
+};
+
+/*! \brief `std::vector` with its elements allocated from an Arena */
+template<typename T> using ArenaVector= std::vector<T, ArenaAllocator<T>>;
+
+/*! \brief `std::string` with its characters allocated from an Arena */
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+
+//***************************************************************************
+} // namespace cex
+
+#endif // __ARENA_HPP_
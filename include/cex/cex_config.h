@@ -5,6 +5,16 @@
 
 #undef CEX_WITH_SSL
 #undef CEX_WITH_ZLIB
+#undef CEX_WITH_ZSTD
+#undef CEX_WITH_BROTLI
+#undef CEX_WITH_CHAIN_TIMING
 
 #define CEX_WITH_SSL
 #define CEX_WITH_ZLIB
+/* #undef CEX_WITH_ZSTD */
+/* #undef CEX_WITH_BROTLI */
+#define CEX_WITH_CHAIN_TIMING
+
+#if defined(CEX_WITH_ZLIB) || defined(CEX_WITH_ZSTD) || defined(CEX_WITH_BROTLI)
+#  define CEX_WITH_COMPRESSION
+#endif
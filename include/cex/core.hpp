@@ -19,17 +19,30 @@
 #include <event2/thread.h>
 
 #include <thread>
+#include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <mutex>
+#include <memory>
 #include <string>
+#include <cstring>
 #include <vector>
 #include <regex>
 
+#include <arena.hpp>
+#include <executor.hpp>
 #include <plist.hpp>
+#include <regex.hpp>
 #include <cex/cex_config.h>
 
 #define IO_BUFFER_SIZE 128*1024
+#define CEX_CONTEXT_POOL_SIZE 256         // recycled request contexts per worker thread (0: disable)
+#define CEX_CONTEXT_POOL_MAX_BODY 1024*1024   // body buffers above this capacity are not kept
+#define CEX_DEFLATE_POOL_SIZE 8           // idle zlib/zstd streams kept per worker thread
+#define CEX_STREAM_LOW_WATERMARK IO_BUFFER_SIZE      // streamed responses: read on when less output is pending
+#define CEX_STREAM_HIGH_WATERMARK 4*IO_BUFFER_SIZE   // streamed responses: pause reading at this much pending output
+#define CEX_MAX_CHAIN_DEPTH 64            // nested next() calls run right away, deeper ones after the function returned
+#define CEX_MAX_PATH_PARAMS 32            // path parameters per route (Router)
 
 namespace cex
 {
@@ -90,6 +103,11 @@ enum Protocol
 
 class Request;
 class Response;
+class DeferredResponse;
+class Middleware;
+class Chain;
+class Metrics;
+struct MetricsSnapshot;
 
 /*! \brief Returns the library version as string */
 const char* getLibraryVersion();
@@ -100,13 +118,47 @@ const char* getLibraryVersion();
 
 typedef std::shared_ptr<Request> ReqPtr;
 typedef std::shared_ptr<Response> ResPtr;
+typedef std::shared_ptr<DeferredResponse> DeferredPtr;
+
+//***************************************************************************
+// class Next
+//***************************************************************************
+/*! \class Next
+  \brief Handle passed to each middleware function, which continues the middleware chain when called.
+
+  The handle only points to the request's Chain, so it is cheap to copy. It converts implicitly to
+  `std::function<void()>`, so middleware functions declared with a `std::function<void()> next` parameter
+  keep working (without allocating, since the handle fits into the function's small buffer).
+
+  Calling `next()` runs the following middlewares right away, so code after `next()` sees their result
+  (e.g. `next(); if (!res->isDone()) res->end(404);`). Non-matching middlewares are skipped in a loop, and
+  beyond `CEX_MAX_CHAIN_DEPTH` nested calls the following middleware is started as soon as the current
+  function has returned instead, so the stack does not grow with the number of attached middlewares.
+  In an offloaded middleware (`Middleware::fOffload`), `next()` always runs after the function returned.
+  If the following middleware is offloaded, `next()` returns once it was passed to the pool, and the response
+  can't be changed or sent by the caller until the offloaded function's response was sent.
+  */
+
+class Next
+{
+   public:
+
+      explicit Next(Chain* chain) : chain(chain) {}
+
+      /*! \brief Continues with the next matching middleware */
+      void operator()() const;
+
+   private:
+
+      Chain* chain;
+};
 
 /*! \public
    \brief A function which is called by a standard Middleware when an incoming request matches.
    \param req The Request object representing the matched request 
    \param res The corresponding Response object which allows to create/send a response to the client 
-   \param next A function to call when the next middleware shall be evaluated. */
-typedef std::function<void(Request* req, Response* res, std::function<void()> next)> MiddlewareFunction;
+   \param next A handle to call when the next middleware shall be evaluated. */
+typedef std::function<void(Request* req, Response* res, Next next)> MiddlewareFunction;
 
 /*! \public
    \brief A function which is called by an upload Middleware when an incoming request matches.
@@ -115,7 +167,8 @@ typedef std::function<void(Request* req, Response* res, std::function<void()> ne
    to disk or loaded into memory).
 
    The function is called repeatedly, depending on the size of the upload. Following middlewares will not be called
-   until the upload is finished.
+   until the upload is finished. `data` points directly into the connection's receive buffer and is only valid during
+   the call.
    \param req The Request object representing the matched request 
    \param data The current data block of the upload
    \param len The number of bytes of the current data block 
@@ -133,6 +186,40 @@ typedef std::pair<std::string,bool> MimeType;
 typedef std::unordered_map<std::string, MimeType> MimeTypes;
 typedef std::unique_ptr<std::thread, std::function<void(std::thread* t)>> ThreadPtr;
 typedef std::unique_ptr<event_base, std::function<void(event_base*)>> EventBasePtr;
+typedef std::unique_ptr<evhtp_t, std::function<void(evhtp_t*)>> HttpServerPtr;
+
+//***************************************************************************
+// class StringView
+//***************************************************************************
+/*! \class StringView
+  \brief A non-owning reference to a range of characters (pointer + length).
+
+  Used to hand out slices of buffers owned by `libevhtp` (e.g. path parameters) without copying them.
+  The referenced characters are **not** null-terminated, and are only valid as long as the request exists.
+  Use `str()` to get an owning copy.
+  */
+
+class StringView
+{
+   public:
+
+      StringView() : ptr(0), len(0) {}
+      StringView(const char* data, size_t size) : ptr(data), len(size) {}
+
+      const char* data() const { return ptr; }    /*!< \brief Returns the pointer to the first character */
+      size_t size() const { return len; }         /*!< \brief Returns the number of characters */
+      bool empty() const { return !len; }         /*!< \brief Returns `true` if the view has no characters */
+      std::string str() const { return ptr ? std::string(ptr, len) : std::string(); }   /*!< \brief Returns a copy of the characters */
+
+      /*! \brief Compares the view with a null-terminated string */
+      bool operator==(const char* other) const { return other && !strncmp(ptr ? ptr : "", other, len) && !other[len]; }
+      bool operator!=(const char* other) const { return !(*this == other); }
+
+   private:
+
+      const char* ptr;
+      size_t len;
+};
 
 //***************************************************************************
 // class Request
@@ -175,6 +262,8 @@ class Request
    friend class Server;
    friend class Response;
    friend class Middleware;
+   friend class Router;
+   friend class Chain;
 
    public:
 
@@ -182,6 +271,7 @@ class Request
         \param req The underlying `libevhtp` request object 
        */
       explicit Request(evhtp_request* req);
+      ~Request();
 
      // base request info
 
@@ -195,6 +285,17 @@ class Request
 
       const char* getMiddlewarePath();   /*!< Returns the path of the currently matched Middleware */
 
+      // path parameters
+
+      /*! \brief Returns the value of a path parameter of the currently matched Middleware
+
+        For a middleware attached with the path `/users/:id/orders/:oid`, the request `/users/10/orders/7` yields
+        `getParam("id") == "10"` and `getParam("oid") == "7"`. The returned view points directly into the request's
+        URL buffer (no copy, not null-terminated, not URL-decoded).
+        \param name Name of the parameter (without leading `:`)
+        \return The parameter value, or an empty view if the middleware has no such parameter */
+      StringView getParam(const char* name);
+
       // HTTP header related
 
       /*! \brief Iterates all HTTP headers of the request with the given callback function
@@ -219,8 +320,15 @@ class Request
 
       // request body
 
-      const char* getBody();     /*!< Returns the RAW body contents of the request  (unparsed, can be binary data)*/
+      const char* getBody();     /*!< Returns the RAW body contents of the request  (unparsed, can be binary data). With Server::Config::zeroCopyBody, the body chunks are joined into one buffer on the first call.*/
       size_t getBodyLength();    /*!< Returns the length of RAW body contents (number of bytes) */
+
+      /*! \brief Returns the RAW body contents as list of chunks, without copying them into one buffer.
+
+        With Server::Config::zeroCopyBody, the chunks are the buffers of the body as they were received from the connection.
+        Otherwise (or after getBody() was called), the list contains a single chunk. The views are valid until the body is
+        modified by getBody() or the request is finished. */
+      const std::vector<StringView>& bodyChunks();
  
       // CEX properties (sessionId, sslClientCert, ...)
 
@@ -234,9 +342,17 @@ class Request
 
       PropertyList properties;
 
+      /*! \brief Returns the request's Arena for temporary allocations.
+
+        All memory allocated from the arena is released at once when the request is finished, so middlewares can
+        make many small allocations (e.g. `req->arena().strdup(value)`, ArenaVector, ArenaString) without
+        calling `malloc`/`free` for each of them. The memory must not be used after the request is finished. */
+      Arena& arena() { return requestArena; }
+
    private:
 
       void parse();
+      void reset(evhtp_request* req);
 
       static int keyValueIteratorCb(evhtp_kv_t * kv, void * arg);
 
@@ -251,6 +367,32 @@ class Request
       Protocol protocol;
       std::string middlewarePath;
       std::vector<char> body;
+      struct evbuffer* bodyBuffer;                  // zeroCopyBody: received chunks, following `body`
+      std::vector<StringView> chunks;
+
+      const std::vector<std::string>* paramNames;   // of the currently matched middleware
+      const std::vector<StringView>* paramValues;   // of all candidates (see Chain), may grow while the chain runs
+      size_t paramOffset;                           // of the currently matched middleware's values
+
+      Arena requestArena;
+};
+
+//***************************************************************************
+// struct CompressionOptions
+//***************************************************************************
+/*! \struct CompressionOptions
+  \brief Parameters used to compress responses (see `Server::Config::compressLevel` etc.) */
+
+struct CompressionOptions
+{
+   CompressionOptions() : level(-1), memLevel(8), windowBits(15), minBytes(0), brotliQuality(4), zstdLevel(3) {}
+
+   int level;        /*!< \brief Compression level, 0-9 (default: -1, zlib's default level 6) */
+   int memLevel;     /*!< \brief Memory used for the compression state, 1-9 (default: 8) */
+   int windowBits;   /*!< \brief Size of the history window, 9-15 (default: 15) */
+   size_t minBytes;  /*!< \brief Smaller bodies are not compressed (default: 0) */
+   int brotliQuality; /*!< \brief brotli quality, 0-11 (default: 4) */
+   int zstdLevel;    /*!< \brief zstd compression level, 1-19 (default: 3) */
 };
 
 //***************************************************************************
@@ -275,6 +417,9 @@ Example:
 
 class Response
 {
+   friend class Server;
+   friend class Chain;
+
    public:
 
       /*! \brief State of the response. */
@@ -286,7 +431,7 @@ class Response
 
       /*! \brief Flags describing features of the response. Currently this affects only compression. 
        
-        For compression to work, the library must be compiled with zlib support.
+        For compression to work, the library must be compiled with zlib support (gzip, deflate), zstd support or brotli support.
        */
       enum Flags
       {
@@ -294,13 +439,16 @@ class Response
 
          fCompression=     0x000F,
          fCompressGZip=    0x0001,  /*!< Enable GZip compression of the response contents */
-         fCompressDeflate= 0x0002   /*!< Enable deflate compression of the response contents */
+         fCompressDeflate= 0x0002,  /*!< Enable deflate compression of the response contents */
+         fCompressBrotli=  0x0004,  /*!< Enable brotli compression of the response contents */
+         fCompressZstd=    0x0008   /*!< Enable zstd compression of the response contents */
       };
 
       /*! \brief Constructs a new `Response` object 
         \param req The underlying `libevhtp` request object 
        */
       explicit Response(evhtp_request* req);
+      ~Response();
 
       /*! \brief Sets a HTTP header to a given value
         \param name Name of the HTTP header
@@ -332,15 +480,63 @@ class Response
        */ 
       int end(int status);
 
+      /*! \brief Sends a response to the client with the supplied HTTP code and the contents of an evbuffer
+       \param body The buffer holding the response body. Its contents are moved (not copied) into the reply, so it may
+       contain references (`evbuffer_add_reference`) and file segments (`evbuffer_add_file`). It is empty afterwards.
+       \param status The HTTP code which shall be sent to the client.
+
+       The `Content-Length` header is set to the length of the buffer. The response is sent as is, compression flags
+       are **not** applied.
+       */ 
+      int end(struct evbuffer* body, int status);
+
+      /*! \brief Sends the reply headers with the supplied HTTP code, and lets a callback write the body directly into the connection's output buffer
+       \param status The HTTP code which shall be sent to the client.
+       \param contentLength The exact number of bytes `writeBody` will add (sent as `Content-Length`)
+       \param writeBody Adds the body to the output buffer, returns `cex::done` on success or `cex::fail`
+
+       File segments added by `writeBody` (`evbuffer_add_file_segment`) are transferred with `sendfile()` on plain connections. If
+       `writeBody` fails, the headers were already sent, so the connection is closed after the reply. The response is sent as is,
+       compression flags are **not** applied. Within an offloaded middleware (see `Middleware::fOffload`), `writeBody` is called
+       right away with a temporary buffer, whose contents are sent by the event loop afterwards.
+       */ 
+      int end(int status, size_t contentLength, const std::function<int(struct evbuffer* output)>& writeBody);
+
       /*! \brief Streams a response to the client with the supplied HTTP code
        \param status The HTTP code which shall be sent to the client.
        \param stream A pointer to a `std::istream` instance which is used to read the response contents from.
        \return `cex::success` (0) if the whole contents were successfully transferred or `cex::fail` (-1) if the stream could not be read.
       
-       This function is useful for transferring larger payloads (e.g. files) which shall not be fully loaded into memory.
+       The whole stream is read before the function returns, and queued for sending as fast as it can be read. For large
+       payloads and slow clients, prefer the overload taking ownership of the stream, which only reads as fast as the client receives.
        */ 
       int stream(int status, std::istream* stream);
 
+      /*! \brief Streams a response to the client with the supplied HTTP code, reading the stream as the client receives the data
+       \param status The HTTP code which shall be sent to the client.
+       \param stream The stream to read the response contents from. Ownership is taken over, the stream is destroyed when
+       the response was sent or the connection was closed.
+       \return `cex::done` if streaming was started or `cex::fail` if the stream could not be read.
+
+       Chunks are read (and compressed, if enabled) while less than `CEX_STREAM_LOW_WATERMARK` bytes are waiting to be sent, up to
+       `CEX_STREAM_HIGH_WATERMARK` bytes. The rest of the stream is read from the connection's write callback, after the middleware
+       function returned, so the memory used for a slow download stays bounded.
+       */ 
+      int stream(int status, std::unique_ptr<std::istream> stream);
+
+      /*! \brief Sends (a part of) a file to the client with the supplied HTTP code
+       \param status The HTTP code which shall be sent to the client.
+       \param fd The file descriptor of the opened file. Ownership is taken over, the descriptor is closed when the file was sent (or on failure).
+       \param offset The offset of the first byte to send
+       \param length The number of bytes to send
+       \return `cex::done` if the reply was sent or `cex::fail` if the file could not be sent.
+
+       The file contents are not read into user space; `libevent` transfers them to the socket using `sendfile()` (or `mmap()`, if
+       `sendfile()` is not available, e.g. for SSL connections). The `Content-Length` header is set to `length`. The response is sent as is, compression
+       flags are **not** applied.
+       */ 
+      int sendFile(int status, int fd, size_t offset, size_t length);
+
       /*! \brief Queries the state of the response.
         \param aState The state which shall be compared to the response object state
         \return `true` if the state of the object matches the supplied state, otherwise `false`.
@@ -364,13 +560,145 @@ class Response
       /*! \brief Returns the currently set flags of the response object */
       int getFlags() { return flags; };
 
+      /*! \brief Returns the compression options used for the response (as configured in Server::Config) */
+      const CompressionOptions& getCompressionOptions() { return compression; }
+
+      /*! \brief Checks whether a body would be compressed when it is sent
+        \param length The length of the body (`(size_t)-1` if unknown)
+        \param contentType The content type of the body. If `nullptr`, the `Content-Type` header set on this response is used.
+        \return `true` if a compression flag is set, the body is not smaller than `Server::Config::compressMinBytes`, and the
+        content type is compressible (see `Server::isCompressible`) */
+      bool compressible(size_t length, const char* contentType= nullptr);
+
+      /*! \brief Returns a handle to complete the response later, from any thread
+        \return The handle (the same one, if called repeatedly for a request), or an empty pointer on failure.
+
+        The middleware function returns without sending a response, and the response is sent with one of the `end()` functions of
+        the handle, e.g. from a thread waiting for a database query. See `DeferredResponse`. */
+      DeferredPtr defer();
+
    private:
 
+      struct Streaming;
+
+      void reset(evhtp_request* req);
+      void stopStreaming();
+      void cancelDeferred();
+
       static evhtp_res sendChunk(evhtp_connection_t* conn, void* arg);
 
+      // offloaded middleware functions (see Middleware::fOffload): sending the response is passed to the
+      // event loop, and runs after the function returned
+
+      int postOffloaded(std::function<void()> op) { offloadOps.push_back(std::move(op)); return done; }
+
+      // an offloaded function owns the response, other threads/middlewares must not touch it
+      bool ownedByPool() const { return offloaded && offloading != this; }
+
+      static thread_local Response* offloading;   // response of the offloaded function run by this thread
+
       evhtp_request* req;
       State state;
       int flags;
+      CompressionOptions compression;
+      std::unique_ptr<Streaming> streaming;
+      DeferredPtr deferred;
+      std::vector<std::function<void()>> offloadOps;
+      bool offloaded;          // from submitting an offloaded function until its response is attached again
+
+      // metrics (see Server::getMetrics)
+
+      size_t bytesOut;         // body bytes passed to the connection
+      size_t compressedIn;     // body bytes passed to compression
+      size_t compressedOut;    // compressed bytes produced from them
+};
+
+//***************************************************************************
+// class DeferredResponse
+//***************************************************************************
+/*! \class DeferredResponse
+  \brief Thread-safe handle to complete a response outside of its middleware function (see `Response::defer`).
+
+  The functions of the handle may be called from any thread. They don't touch the response directly, but pass the work
+  to the event loop of the request's worker thread (using `event_active`), which sends the response. If the client
+  closes the connection before the response was sent, the queued work is discarded. Handles must not be used after
+  the server was stopped.
+
+  ```
+   app.get("/users/:id", [&db](cex::Request* req, cex::Response* res, cex::Next next)
+   {
+      cex::DeferredPtr deferred= res->defer();
+      std::string id= req->getParam("id").str();
+
+      db.queryAsync(id, [deferred](const std::string& json)
+      {
+         deferred->run([json](cex::Response* res) { res->set("Content-Type", "application/json"); });
+         deferred->end(json.c_str(), json.size(), 200);
+      });
+   });
+  ```
+  */
+
+class DeferredResponse : public std::enable_shared_from_this<DeferredResponse>
+{
+   friend class Response;
+
+   public:
+
+      ~DeferredResponse();
+
+      DeferredResponse(const DeferredResponse&)= delete;
+      DeferredResponse& operator=(const DeferredResponse&)= delete;
+
+      /*! \brief Sends the response with the supplied HTTP code and payload text (copied)
+        \return `cex::done` if the response was queued, `cex::fail` if it was already completed or the request is gone */
+      int end(const char* string, int status);
+
+      /*! \brief Sends the response with the supplied HTTP code and payload buffer (copied)
+        \return `cex::done` if the response was queued, `cex::fail` if it was already completed or the request is gone */
+      int end(const char* buffer, size_t bufLen, int status);
+
+      /*! \brief Sends the response with the supplied HTTP code and no body
+        \return `cex::done` if the response was queued, `cex::fail` if it was already completed or the request is gone */
+      int end(int status);
+
+      /*! \brief Calls `func` with the response on the request's worker thread, e.g. to set headers, or to send the response
+        with one of the other `Response` functions. Functions are called in the order they were queued.
+        \return `cex::done` if the function was queued, `cex::fail` if the response was already completed or the request is gone */
+      int run(std::function<void(Response* res)> func);
+
+      /*! \brief Returns `true` if the request is gone (e.g. the client closed the connection), so there is no use in completing it */
+      bool isCancelled();
+
+      /*! \brief Registers a function which is called on the worker thread when the request is finished while this handle
+        exists (e.g. the client closed the connection, or the response was sent). Must be called on the worker thread.
+        \return An id for `removeCancelHandler` */
+      unsigned int addCancelHandler(std::function<void()> func);
+
+      /*! \brief Removes a function registered with `addCancelHandler`. Must be called on the worker thread. */
+      void removeCancelHandler(unsigned int id);
+
+      /*! \brief Returns the event loop of the request's worker thread */
+      struct event_base* getEventBase();
+
+   private:
+
+      DeferredResponse(Response* res, struct event_base* base);
+
+      int queue(std::function<void(Response* res)> func, bool last);
+      void cancel();
+
+      static void onEvent(evutil_socket_t fd, short what, void* arg);
+
+      std::mutex mutex;
+      std::vector<std::function<void(Response* res)>> pending;
+      std::shared_ptr<DeferredResponse> self;  // keeps the handle alive while work is queued
+      std::vector<std::pair<unsigned int, std::function<void()>>> cancelHandlers;
+      Response* res;          // only accessed on the worker thread
+      struct event* ev;
+      unsigned int nextHandlerId;
+      bool completed;
+      bool cancelled;
 };
 
 //***************************************************************************
@@ -384,6 +712,8 @@ class Response
 class Middleware
 {
    friend class Server;
+   friend class Router;
+   friend class Chain;
 
    public:
 
@@ -393,7 +723,11 @@ class Middleware
          fMatchContain= 0x001,  /*!< Match if the request's URL contains the Middleware path */
          fMatchCompare= 0x002,  /*!< Match if the request's URL equals the Middleware path */
          fMatchRegex=   0x004,  /*!< Perform a regular expression match with the Middleware path as pattern */
-         fMatching=     0x00F
+         fMatchParams=  0x008,  /*!< Match if the request's URL equals the Middleware path, with `:name` segments matching any single path segment.
+                                     Set automatically for (non-regex) paths containing `:name` segments. */
+         fMatching=     0x00F,
+
+         fOffload=      0x100   /*!< Run the middleware function on the server's offload thread pool instead of the event loop (see `Server::Config::offloadThreadCount`) */
       };
 
       /*! \brief Type of middleware */
@@ -411,20 +745,168 @@ class Middleware
       Middleware(const char* path, MiddlewareFunction func, int method= na, int flags= fMatchContain);
       Middleware(const char* path, UploadFunction func, int method= na, int flags= fMatchContain);
 
-      bool match(Request* req);
+      /*! \brief Checks if the request matches the middleware's method and path
+        \param req The request to check
+        \param params If not null, receives the path parameter values (`fMatchParams` only)*/
+      bool match(Request* req, std::vector<StringView>* params= nullptr);
       const char* getPath() { return path.c_str(); }
 
    private:
 
+      void parsePath();
+      bool matchParams(const char* url, std::vector<StringView>* params);
+
       int type;
       int method;
       int flags;
-      std::regex rep;
+      Regex regex;                        // fMatchRegex: linear-time automaton ...
+      std::unique_ptr<std::regex> rep;    // ... or std::regex for patterns it does not support
       std::string path;
+      std::vector<std::string> paramNames;
       MiddlewareFunction func;
       UploadFunction uploadFunc; 
 };
 
+//***************************************************************************
+// class Router
+//***************************************************************************
+/*! \class Router
+  \brief Compiled lookup structure for the middlewares attached to a Server.
+
+  Built once by Server::listen() from the registered middlewares. Holds one prefix tree per HTTP method,
+  so that a request only needs a single pass over its URL to find all middlewares whose path matches, instead
+  of calling Middleware::match() for each attached middleware.
+
+  \li `fMatchCompare` paths are looked up by walking the tree from its root
+  \li `fMatchContain` paths are found with an Aho-Corasick scan over the same tree (failure links)
+  \li `fMatchRegex` paths of a method are merged into one automaton (see Regex), so a single scan finds all matching patterns
+  \li middlewares without path are candidates for every request of their method
+
+  The resulting chain contains the middleware indices in registration order, so the execution order of
+  global and path based middlewares is exactly the same as without the router.
+  */
+
+class Router
+{
+   public:
+
+      /*! \brief A single candidate middleware of a request's chain */
+      struct Entry
+      {
+         Entry(int index, int paramOffset= 0, bool verify= false) : index(index), paramOffset(paramOffset), verify(verify) {}
+
+         int index;         /*!< \brief Index of the middleware in the server's middleware list */
+         int paramOffset;   /*!< \brief Offset of the middleware's path parameter values in the request's parameter list */
+         bool verify;       /*!< \brief `true` if the middleware still must be checked with Middleware::match() */
+
+         bool operator<(const Entry& other) const { return index < other.index; }
+         bool operator==(const Entry& other) const { return index == other.index; }
+      };
+
+      Router() : compiledCount(0) {}
+
+      /*! \brief Builds the lookup tables from the given middlewares. Replaces any previously compiled tables.
+        \param wares The middlewares to compile
+        \param mergeRegex If `true`, all `fMatchRegex` paths of a method are merged into a single automaton */
+      void compile(const std::vector<std::unique_ptr<Middleware>>& wares, bool mergeRegex= true);
+
+      /*! \brief Drops the compiled tables */
+      void clear();
+
+      /*! \brief Collects all candidate middlewares for a request (in registration order)
+        \param req The request whose method and URL shall be looked up
+        \param count The number of currently attached middlewares
+        \param chain Receives the candidate entries
+        \param params Receives the path parameter values of all `fMatchParams` candidates
+        \return `true` if the chain was built from the compiled tables, `false` if the tables are outdated (chain then
+        contains all middlewares, which must be checked with Middleware::match()) */
+      bool lookup(Request* req, size_t count, std::vector<Entry>& chain, std::vector<StringView>& params);
+
+   private:
+
+      struct Node
+      {
+         Node() : param(na), fail(0), output(0) {}
+
+         std::vector<std::pair<unsigned char,int>> children;  // sorted by character
+         int param;                                           // child matching a single `:name` path segment
+         std::vector<int> exact;                              // fMatchCompare/fMatchParams middlewares ending here
+         std::vector<int> contain;                            // fMatchContain middlewares ending here
+         int fail;                                            // Aho-Corasick failure link
+         int output;                                          // next node on the failure chain with contain-entries
+      };
+
+      struct Table
+      {
+         Table() : nodes(1), hasContain(false) {}
+
+         std::vector<Node> nodes;                             // nodes[0] is the root
+         std::vector<Entry> always;                           // middlewares without path, and unmerged regex middlewares
+         bool hasContain;
+         Regex regexSet;                                      // all merged regex paths of the method
+         std::vector<int> regexWares;                         // middleware index per regexSet pattern id
+      };
+
+      int insert(Table& table, const std::string& path, bool params);
+      void link(Table& table);
+      void walk(const Table& table, int node, const char* p, StringView* captures, int depth, std::vector<Entry>& chain, std::vector<StringView>& params);
+
+      static int child(const Node& node, unsigned char c);
+
+      std::vector<Table> tables;                              // indexed by libevhtp method (htp_method_UNKNOWN == unknown)
+      size_t compiledCount;
+};
+
+//***************************************************************************
+// class Chain
+//***************************************************************************
+/*! \class Chain
+  \brief Cursor over the candidate middlewares of a single request.
+
+  Executes the middlewares one after another in a loop. A middleware function continues the chain by
+  calling its Next handle, either while it is running (the loop then picks up the following middleware
+  once the function returned), or later on (which restarts the loop from the current position).
+  */
+
+class Chain
+{
+   public:
+
+      Chain() : wares(nullptr), req(nullptr), res(nullptr), metrics(nullptr), pos(0), calledWare(na), routeWare(na), nested(0), depth(0), routed(false), pending(false) {}
+
+      /*! \brief Starts processing the candidates found by Router::lookup()
+        \param wares The server's middlewares
+        \param req The request to process
+        \param res The corresponding response
+        \param routed The result of Router::lookup() */
+      void start(const std::vector<std::unique_ptr<Middleware>>* wares, Request* req, Response* res, bool routed);
+
+      /*! \brief Runs the next matching middleware (see Next) */
+      void next();
+
+      /*! \brief Passes middlewares attached with `Middleware::fOffload` to the offload thread pool. Returns `false` if
+        the middleware shall run on the calling thread. */
+      std::function<bool(Middleware* ware)> offload;
+
+   private:
+
+      friend class Server;
+
+      const std::vector<std::unique_ptr<Middleware>>* wares;
+      Request* req;
+      Response* res;
+      Metrics* metrics;                     // records the time per middleware function (CEX_WITH_CHAIN_TIMING)
+      std::vector<Router::Entry> entries;   // candidate middlewares as found by the Router
+      std::vector<StringView> params;       // path parameter values of the candidates
+      size_t pos;                           // next entry to evaluate
+      int calledWare;                       // last called middleware, na if none
+      int routeWare;                        // last called middleware with a path (metrics), na if none
+      uint64_t nested;                      // time spent in middlewares called by the current one (metrics)
+      int depth;                            // nested next() calls currently running
+      bool routed;
+      bool pending;                         // next() was called beyond CEX_MAX_CHAIN_DEPTH
+};
+
 //***************************************************************************
 // class Server
 //***************************************************************************
@@ -436,6 +918,8 @@ class Server
 {
    public:
 
+      struct Detached;
+
       /*! \struct Context
         \brief Internal helper struct for handling libevhtp callback functions
        */
@@ -443,11 +927,30 @@ class Server
       struct Context
       {
          Context(evhtp_request_t* request, Server* serv)
-            : req(new Request(request)), res(new Response(request)), serv(serv) {}
+            : req(new Request(request)), res(new Response(request)), serv(serv), contentLength(0), bodyBytes(0), rejected(false), uploadWare(nullptr), offloadState(0), detached(nullptr)
+         {
+            chain.offload= [this](Middleware* ware) { return Server::offload(this, ware); };
+         }
+
+         ~Context();
+
+         /*! \brief Prepares a recycled context for a new request (keeps the allocated buffers) */
+         void reset(evhtp_request_t* request, Server* serv);
 
          ReqPtr req;
          ResPtr res;
          Server* serv;
+         Chain chain;
+         size_t contentLength;   // as announced by the client (0: unknown)
+         size_t bodyBytes;       // received so far
+         bool rejected;          // body too large, already answered with 413
+         Middleware* uploadWare; // matching upload middleware (resolved once per request)
+
+         std::mutex offloadMutex;  // offloaded middleware function (see Server::offload)
+         int offloadState;
+         Detached* detached;       // copy of the request the function works on
+
+         std::chrono::steady_clock::time_point begin;   // request headers received (metrics)
       };
 
       /*! \struct Config
@@ -467,12 +970,36 @@ class Server
 
          bool compress;         /*!< \brief Globally enable compression of outgoing responses (default: true).
 
-                                  This will enable gzip/deflate compression of responses if Accept-Encoding allows compressioni (default: false).\n Compression can be enabled/disabled manually for a single request using the request flags. For example: `res.get()->setFlags(res.get()->getFlags() | Response::fCompressGZip)`. \n \n Library **must** be built with `libz` to make this work. */
+                                  This will enable gzip/deflate (and zstd/brotli, if available) compression of responses if Accept-Encoding allows compressioni (default: false).\n Compression can be enabled/disabled manually for a single request using the request flags. For example: `res.get()->setFlags(res.get()->getFlags() | Response::fCompressGZip)`. \n \n Library **must** be built with `libz`, `libzstd` or `libbrotlienc` to make this work. */
          bool parseSslInfo;     /*!< \brief Flag indicating whether or not SSL client info shall be parsed for each request (default: true). 
                                   
                                   This tries to extract the SSL certificate provided by the client and store it into a CertificateInfo structure within the requests `sslClientCert` property. */
          bool sslEnabled;       /*!< \brief Flag indicating whether or not SSL is enabled on the listener (default: false). */
+         bool mergeRegexRoutes; /*!< \brief Merge all `fMatchRegex` paths into one automaton per HTTP method (default: true).
+
+                                  A single scan of the URL then decides which of the regex middlewares match, instead of one scan per middleware. */
          int threadCount;       /*!< \brief Controls the number of worker threads the server is going to use (default: 4). */
+         int offloadThreadCount; /*!< \brief Number of threads running middlewares attached with `Middleware::fOffload` (default: 0, one per CPU core).
+
+                                  The threads are separate from the event loop threads (`threadCount`, `reactorCount`), and are only started if such a middleware is attached. */
+         size_t compressMinBytes; /*!< \brief Responses with smaller bodies are not compressed (default: 256). Streamed responses of unknown length are not affected. */
+         int compressLevel;     /*!< \brief zlib compression level, 0-9 (default: -1, zlib's default level 6) */
+         int compressMemLevel;  /*!< \brief zlib `memLevel`, 1-9 (default: 8). Lower values use less memory per compressed response, but compress worse. */
+         int compressBrotliQuality; /*!< \brief brotli quality, 0-11 (default: 4). Only used if the library was built with brotli. */
+         int compressZstdLevel; /*!< \brief zstd compression level, 1-19 (default: 3). Only used if the library was built with zstd. */
+         int compressWindowBits; /*!< \brief zlib `windowBits`, 9-15 (default: 15). Lower values use less memory per compressed response, but compress worse. */
+         size_t maxBodySize;    /*!< \brief Maximum size of a request body in bytes (default: 0, unlimited).
+
+                                  Requests announcing a larger `Content-Length` are answered with 413 right after the headers were received, without buffering any body data. Requests exceeding the limit while the body is received (e.g. chunked transfer encoding) are aborted. */
+         bool zeroCopyBody;     /*!< \brief Keep the request body as chain of received buffers (default: false).
+
+                                  The buffers are moved from the connection into the request instead of being copied into one growing buffer per received chunk. They can be accessed with Request::bodyChunks(); Request::getBody() joins them into one buffer on demand. */
+         int reactorCount;      /*!< \brief Number of independent event loops (default: 0).
+
+                                  If greater than 0, the server runs `reactorCount` event loops in separate threads, each with its own listener socket bound with `SO_REUSEPORT`. The kernel distributes incoming connections among the listeners, and requests are processed in the thread which accepted the connection. `threadCount` is ignored in this mode. */
+         bool pinReactors;      /*!< \brief Pin each reactor thread to a CPU core (default: false). Linux only, requires `reactorCount` > 0. */
+         int backlog;           /*!< \brief Listen backlog of the listener socket(s) (default: 128). */
+         bool metrics;          /*!< \brief Collect request, connection and latency metrics (default: true). See `Server::getMetrics()`. */
 
 #ifdef CEX_WITH_SSL
          int sslVerifyMode;
@@ -506,10 +1033,15 @@ class Server
       /*! \brief Stops the listener. If it was started within a background thread, the background thread is terminated. */
       int stop();
 
+      /*! \brief Returns the metrics collected since the server was started (empty if `Config::metrics` is disabled).
+
+        Can be called from any thread, e.g. by a middleware (see `metricsHandler`). Include `<cex/metrics.hpp>` to use the result. */
+      MetricsSnapshot getMetrics();
+
       // router
 
       /*! \brief Removes all attached middlewares */
-      void reset() { middleWares.clear(); }
+      void reset() { middleWares.clear(); router.clear(); }
 
       /*! \brief Attaches a middleware function with no conditions 
         
@@ -775,6 +1307,12 @@ class Server
       static MimeTypes* getMimeTypes() { return mimeTypes.get(); }
       static void registerMimeType(const char* ext, const char* mime, bool binary);
 
+      /*! \brief Checks if responses with the given content type are worth compressing.
+
+        Types registered as non-binary in the mime types table are compressible, binary ones (images, archives, ...) are not.
+        Unknown types are compressible if they start with `text/`. Parameters (e.g. `; charset=utf-8`) are ignored. */
+      static bool isCompressible(const char* contentType);
+
       // SSL/TLS
 
 #ifdef CEX_WITH_SSL
@@ -786,7 +1324,23 @@ class Server
 
    private:
 
+      /*! \struct Reactor
+        \brief Event loop, listener and thread of a single reactor (multi-reactor mode)
+       */
+
+      struct Reactor
+      {
+         Reactor() : eventBase(nullptr, &event_base_free), httpServer(nullptr, &evhtp_free) {}
+
+         EventBasePtr eventBase;
+         HttpServerPtr httpServer;
+         std::thread thread;
+      };
+
       int start(bool block);
+      int startReactors(bool block);
+      int stopReactors();
+      void setup(evhtp_t* httpServer);
 
       static int initMimeTypes();
 
@@ -794,6 +1348,17 @@ class Server
       static evhtp_res handleHeaders(evhtp_request_t* request, evhtp_headers_t* hdr, void* arg);
       static evhtp_res handleBody(evhtp_request_t* req, struct evbuffer* buf, void* arg);
       static evhtp_res handleFinished(evhtp_request_t* req, void* arg);
+      static void releaseContext(Context* ctx);
+
+      static bool offload(Context* ctx, Middleware* ware);
+      static void runOffloaded(Context* ctx, Middleware* ware, struct event_base* base);
+      static void offloadDone(evutil_socket_t fd, short what, void* arg);
+      static void detach(Context* ctx);
+      static void attach(Context* ctx);
+      static void rebaseParams(Context* ctx, const char* from, const char* to);
+      static void recordMetrics(Context* ctx, evhtp_request_t* req);
+      static evhtp_res handleAccept(evhtp_connection_t* conn, void* arg);
+      static evhtp_res handleConnectionClosed(evhtp_connection_t* conn, void* arg);
 
 #ifdef CEX_WITH_SSL
       static int verifyCert(int ok, X509_STORE_CTX* store);
@@ -803,13 +1368,19 @@ class Server
 
       std::vector<std::unique_ptr<Middleware>> middleWares;
       std::vector<std::unique_ptr<Middleware>> uploadWares;
+      Router router;
 
       Config serverConfig;
+      std::unique_ptr<Metrics> metrics;       // outlives the event loops (connection hooks)
+      std::vector<size_t> routeOfWare;        // middleware index -> metrics route (0: no path)
 
       // server control
 
       EventBasePtr eventBase;
       ThreadPtr backgroundThread;
+      std::vector<std::unique_ptr<Reactor>> reactors;   // multi-reactor mode only
+      std::mutex reactorMutex;                          // reactors (stop() may be called from any thread)
+      std::unique_ptr<Executor> offloadPool;            // destroyed first: its jobs post to the event loops
       std::mutex startMutex;
       std::condition_variable startCond;
       bool startSignaled;
@@ -820,6 +1391,7 @@ class Server
       static bool initialized;
       static std::mutex initMutex;
       static std::unique_ptr<MimeTypes> mimeTypes;
+      static std::unique_ptr<std::unordered_map<std::string,bool>> binaryMimeTypes;   // mime type -> binary
 };
 
 //***************************************************************************
@@ -0,0 +1,333 @@
+//*************************************************************************
+// File coroutine.hpp
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// Coroutine middlewares (C++20)
+//*************************************************************************
+
+#ifndef __COROUTINE_HPP__
+#define __COROUTINE_HPP__
+
+/*! \file coroutine.hpp
+  \brief Middleware functions as C++20 coroutines (header only, optional)
+
+  The library itself does not require C++20. Only code including this header must be compiled with coroutine
+  support (e.g. `-std=c++20`).
+*/
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <chrono>
+#include <coroutine>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include <cex/core.hpp>
+
+#if !defined(__cpp_impl_coroutine)
+#  error "cex/coroutine.hpp requires C++20 coroutines (e.g. -std=c++20)"
+#endif
+
+namespace cex
+{
+
+//***************************************************************************
+// class Task
+//***************************************************************************
+/*! \class Task
+  \brief Return type of middleware functions written as coroutines.
+
+  A lambda returning `cex::Task` converts to a MiddlewareFunction, so it is registered with `Server::use/get/...` like
+  any other middleware. The coroutine starts right away, and runs until its first suspension within the middleware
+  call. It is resumed on the request's worker thread (the event loop owning the connection), so `Request` and
+  `Response` may be used as in any middleware function:
+
+  ```
+   app.get("/users/:id", [](cex::Request* req, cex::Response* res, cex::Next next) -> cex::Task
+   {
+      cex::Completion<std::string> result(res);
+
+      db.queryAsync(req->getParam("id").str(), [result](const std::string& json) { result.set(json); });
+
+      std::string json= co_await result;          // resumed on the worker thread
+      co_await cex::sleepFor(std::chrono::milliseconds(10));
+
+      res->end(json.c_str(), json.size(), 200);
+   });
+  ```
+
+  Awaitables:
+  \li `co_await next` continues with the following middlewares, and resumes once they returned (or suspended)
+  \li `co_await cex::sleepFor(duration)` resumes after the duration (timer on the worker's event loop)
+  \li `co_await completion` resumes with the value passed to `Completion::set` from any thread
+
+  When the request is finished while the coroutine is suspended (e.g. the client closed the connection), the coroutine
+  is destroyed at its suspension point (destructors of its local variables run). Other awaitables must not resume a
+  coroutine after its request is finished.
+  */
+
+class Task
+{
+   public:
+
+      struct promise_type
+      {
+         /* the coroutine's parameters are passed to the promise, so it knows the response */
+
+         template<typename... Args>
+         promise_type(Args&... args)
+            : res(nullptr), cancelId(0)
+         {
+            static_assert((std::is_same<typename std::remove_cv<Args>::type, Response*>::value || ...),
+               "cex::Task is meant for middleware functions (Request*, Response*, Next)");
+
+            (pick(args), ...);
+         }
+
+         ~promise_type()
+         {
+            if (cancelId && deferred)
+               deferred->removeCancelHandler(cancelId);
+         }
+
+         Task get_return_object() { return Task(); }
+         std::suspend_never initial_suspend() noexcept { return {}; }
+         std::suspend_never final_suspend() noexcept { return {}; }
+         void return_void() {}
+         void unhandled_exception() { throw; }
+
+         /* `co_await next` */
+
+         auto await_transform(Next next);
+
+         template<typename T>
+         T&& await_transform(T&& awaitable) { return std::forward<T>(awaitable); }
+
+         /* called before the first suspension: destroy the coroutine if its request is finished meanwhile */
+
+         bool arm(std::coroutine_handle<promise_type> handle)
+         {
+            if (!deferred && res)
+               deferred= res->defer();
+
+            if (deferred && !cancelId)
+               cancelId= deferred->addCancelHandler([handle]() { handle.destroy(); });
+
+            return deferred != nullptr;
+         }
+
+         void pick(Response*& aRes) { res= aRes; }
+         template<typename T> void pick(T&) {}
+
+         Response* res;
+         DeferredPtr deferred;
+         unsigned int cancelId;
+      };
+};
+
+//***************************************************************************
+// class NextAwaitable
+//***************************************************************************
+/*! \class NextAwaitable
+  \brief Awaitable of `co_await next` within a Task (see Task) */
+
+class NextAwaitable
+{
+   public:
+
+      explicit NextAwaitable(Next next) : next(next) {}
+
+      bool await_ready() const noexcept { return false; }
+
+      bool await_suspend(std::coroutine_handle<Task::promise_type> handle)
+      {
+         Task::promise_type& promise= handle.promise();
+         Next following= next;
+
+         if (!promise.arm(handle))
+         {
+            following();
+            return false;
+         }
+
+         // queued first, so the coroutine is resumed by the event loop after the following middlewares
+         // returned. if the request is finished before, the cancel handler destroys the coroutine.
+
+         if (promise.deferred->run([handle](Response*) { handle.resume(); }) != done)
+         {
+            following();
+            return false;
+         }
+
+         following();
+
+         return true;
+      }
+
+      void await_resume() const noexcept {}
+
+   private:
+
+      Next next;
+};
+
+inline auto Task::promise_type::await_transform(Next next)
+{
+   return NextAwaitable(next);
+}
+
+//***************************************************************************
+// class SleepAwaitable
+//***************************************************************************
+/*! \class SleepAwaitable
+  \brief Awaitable suspending a Task for a duration (see `sleepFor`) */
+
+class SleepAwaitable
+{
+   public:
+
+      explicit SleepAwaitable(std::chrono::microseconds duration) : duration(duration), ev(nullptr) {}
+      SleepAwaitable(SleepAwaitable&& other) noexcept : duration(other.duration), ev(std::exchange(other.ev, nullptr)), handle(other.handle) {}
+      ~SleepAwaitable() { if (ev) event_free(ev); }
+
+      bool await_ready() const noexcept { return duration.count() <= 0; }
+
+      bool await_suspend(std::coroutine_handle<Task::promise_type> aHandle)
+      {
+         Task::promise_type& promise= aHandle.promise();
+         struct event_base* base= promise.arm(aHandle) ? promise.deferred->getEventBase() : nullptr;
+
+         if (!base || !(ev= evtimer_new(base, SleepAwaitable::onTimer, this)))
+            return false;
+
+         struct timeval tv;
+         tv.tv_sec= duration.count() / 1000000;
+         tv.tv_usec= duration.count() % 1000000;
+
+         handle= aHandle;
+
+         if (evtimer_add(ev, &tv))
+            return false;
+
+         return true;
+      }
+
+      void await_resume() const noexcept {}
+
+   private:
+
+      /* the awaitable lives in the coroutine frame, and frees the timer if the coroutine is destroyed before */
+
+      static void onTimer(evutil_socket_t fd, short what, void* arg)
+      {
+         SleepAwaitable* self= (SleepAwaitable*)arg;
+
+         event_free(self->ev);
+         self->ev= nullptr;
+         self->handle.resume();
+      }
+
+      std::chrono::microseconds duration;
+      struct event* ev;
+      std::coroutine_handle<> handle;
+};
+
+/*! \brief Suspends a Task for the given duration, without blocking the worker thread: `co_await cex::sleepFor(std::chrono::milliseconds(50))` */
+
+template<typename Rep, typename Period>
+inline SleepAwaitable sleepFor(std::chrono::duration<Rep, Period> duration)
+{
+   return SleepAwaitable(std::chrono::duration_cast<std::chrono::microseconds>(duration));
+}
+
+//***************************************************************************
+// class Completion
+//***************************************************************************
+/*! \class Completion
+  \brief Result of an asynchronous operation, awaited by a Task and set from any thread.
+
+  Copies share the result, so a copy can be passed to the code completing the operation (e.g. a callback of a
+  database client). `set` passes the value to the request's worker thread (see DeferredResponse::run), where the
+  awaiting coroutine is resumed. `T` must be copy constructible.
+  */
+
+template<typename T>
+class Completion
+{
+   private:
+
+      struct State
+      {
+         State() : handle(nullptr) {}
+
+         DeferredPtr deferred;
+         std::optional<T> value;       // state is only accessed on the worker thread
+         std::coroutine_handle<> handle;
+      };
+
+   public:
+
+      /*! \brief Constructs a new completion for the request of `res` (within the Task) */
+      explicit Completion(Response* res) : state(std::make_shared<State>()) { state->deferred= res->defer(); }
+
+      /*! \brief Sets the result and resumes the awaiting Task. May be called from any thread, once.
+        \return `cex::done` if the value was passed, `cex::fail` if the request is gone */
+      int set(T value) const
+      {
+         std::shared_ptr<State> shared= state;
+
+         if (!shared->deferred)
+            return fail;
+
+         return shared->deferred->run([shared, value](Response*)
+         {
+            shared->value= value;
+
+            if (shared->handle)
+               std::exchange(shared->handle, nullptr).resume();
+         });
+      }
+
+      class Awaiter
+      {
+         public:
+
+            explicit Awaiter(std::shared_ptr<State> state) : state(std::move(state)) {}
+            ~Awaiter() { state->handle= nullptr; }
+
+            bool await_ready() const noexcept { return state->value.has_value(); }
+
+            bool await_suspend(std::coroutine_handle<Task::promise_type> handle)
+            {
+               if (!handle.promise().arm(handle))
+                  return false;
+
+               state->handle= handle;
+               return true;
+            }
+
+            /* without a value, the request is gone: a default constructed value is returned */
+
+            T await_resume() { return state->value ? std::move(*state->value) : T(); }
+
+         private:
+
+            std::shared_ptr<State> state;
+      };
+
+      Awaiter operator co_await() const { return Awaiter(state); }
+
+   private:
+
+      std::shared_ptr<State> state;
+};
+
+//***************************************************************************
+} // namespace cex
+
+#endif // __COROUTINE_HPP__
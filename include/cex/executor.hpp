@@ -0,0 +1,91 @@
+//*************************************************************************
+// File executor.hpp
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// Class Executor
+//*************************************************************************
+
+#ifndef __EXECUTOR_HPP__
+#define __EXECUTOR_HPP__
+
+/*! \file executor.hpp
+  \brief Work-stealing thread pool, used to run offloaded middlewares
+*/
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cex
+{
+
+//***************************************************************************
+// class Executor
+//***************************************************************************
+/*! \class Executor
+  \brief Fixed size thread pool with one job queue per thread.
+
+  Jobs submitted from outside the pool are appended round-robin to the queues. Jobs submitted by a job are put
+  in front of the queue of the thread running it. Each thread takes jobs from the front of its own queue, and
+  steals from the back of the other queues when its own queue is empty, so a few long running jobs don't hold
+  up the jobs queued behind them.
+
+  The server runs middlewares attached with `Middleware::fOffload` on an executor, so CPU-heavy handlers don't
+  block the event loops (see `Server::Config::offloadThreadCount`).
+  */
+
+class Executor
+{
+   public:
+
+      /*! \brief Starts the threads of the pool
+        \param threads The number of threads. If 0, `std::thread::hardware_concurrency()` threads are started. */
+      explicit Executor(unsigned int threads);
+
+      /*! \brief Runs all jobs still queued, then stops the threads */
+      ~Executor();
+
+      Executor(const Executor&)= delete;
+      Executor& operator=(const Executor&)= delete;
+
+      /*! \brief Queues a job. May be called from any thread. */
+      void submit(std::function<void()> job);
+
+      /*! \brief Returns the number of threads */
+      size_t size() const { return workers.size(); }
+
+   private:
+
+      struct Worker
+      {
+         std::mutex mutex;
+         std::deque<std::function<void()>> jobs;   // own jobs at the front, stolen from the back
+         std::thread thread;
+      };
+
+      void run(size_t index);
+      bool take(size_t index, std::function<void()>& job);
+
+      std::vector<std::unique_ptr<Worker>> workers;
+      std::mutex mutex;
+      std::condition_variable cond;
+      size_t queued;                     // jobs in all queues, guarded by mutex
+      bool stopping;
+      std::atomic<size_t> nextWorker;
+};
+
+//***************************************************************************
+} // namespace cex
+
+#endif // __EXECUTOR_HPP_
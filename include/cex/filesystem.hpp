@@ -31,6 +31,9 @@ Example:
  The `defaultEncoding` is added to the `Content-Type` if it was set and the determined mimetype is not a binary type.
 
  If no mimetype could be found in the internal list, `Content-Type` falls back to `text/plain` with the `defaultEncoding`.
+
+ Responses carry `ETag` and `Last-Modified` headers. Conditional requests (`If-None-Match`, `If-Modified-Since`) are
+ answered with `304 Not Modified` without opening the file.
  
  */
 
@@ -56,13 +59,42 @@ namespace cex
  
 struct FilesystemOptions
 {
-   /*! \brief Constructs a new options object with defaultEncoding `utf-8` and empty rootPath*/
-   FilesystemOptions() : defaultEncoding("utf-8") {}
+   /*! \brief Constructs a new options object with defaultEncoding `utf-8`, empty rootPath and disabled cache */
+   FilesystemOptions() 
+      : defaultEncoding("utf-8"), precompressed(true), etagHash(false), etagHashMaxFileSize(1024*1024), cache(false), cacheMaxBytes(64*1024*1024), cacheMaxEntries(1000),
+        cacheMaxFileSize(1024*1024), cacheRevalidate(1000) {}
 
    std::string rootPath;         /*!< \brief Specifies the root-path on the local filesystem
 
                                   The path of request URLs will be appended as relative paths when accessing files. */
    std::string defaultEncoding;  /*!< \brief The default encoding set in the `Content-Type` header */
+
+   bool precompressed;           /*!< \brief Serves precompressed sibling files (default: `true`)
+
+                                  If a response shall be compressed and a file with the additional extension `.gz` (GZip),
+                                  `.br` (brotli) or `.zst` (zstd) exists next to the requested file (e.g. `app.js.gz` for `app.js`),
+                                  and it is not older than the requested file, its contents are sent instead of compressing the file. */
+
+   bool etagHash;                /*!< \brief Uses a hash of the file contents as `ETag` (default: `false`)
+
+                                  By default, the `ETag` is built from the modification time and size of the file. With this
+                                  option, the file contents are hashed instead. The hash is computed once per version of a
+                                  file, on the event loop (at most `cacheMaxEntries` hashes are kept, the least recently used
+                                  ones are evicted). Files larger than `etagHashMaxFileSize` keep the modification time based `ETag`. */
+   size_t etagHashMaxFileSize;   /*!< \brief Files larger than this are not hashed for the `ETag` (default: 1 MB) */
+   bool cache;                   /*!< \brief Keeps file contents in memory (default: `false`)
+
+                                  Files are read into memory on first access, and are served from there without copying
+                                  and without opening the file again. The least recently used files are evicted when one of
+                                  the limits below is exceeded. The cache is shared by all threads of the middleware.
+                                  Compressed responses are compressed once (with the levels of Server::Config) and kept in the cache as well (per file and
+                                  encoding, limited by the same settings). Each request compares the cached version with the
+                                  file's modification time, size and inode (the `stat()` done for the `ETag` anyway), so a
+                                  modified file is loaded again right away. */
+   size_t cacheMaxBytes;         /*!< \brief Maximum total size of the cached files (default: 64 MB) */
+   size_t cacheMaxEntries;       /*!< \brief Maximum number of cached files (default: 1000) */
+   size_t cacheMaxFileSize;      /*!< \brief Files larger than this are never cached (default: 1 MB) */
+   int cacheRevalidate;          /*!< \brief Not used anymore: cached files are checked with every request (see `cache`) */
 };
 
 /*! \public 
@@ -0,0 +1,262 @@
+//*************************************************************************
+// File metrics.hpp
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// Server metrics (counters, latency histograms, Prometheus export)
+//*************************************************************************
+
+#ifndef __METRICS_HPP__
+#define __METRICS_HPP__
+
+/*! \file metrics.hpp
+  \brief Server metrics and the `metricsHandler` middleware
+
+  The server counts requests, body bytes, response status codes, open connections and compressed bytes, and
+  keeps a latency histogram per middleware path (from the request headers being received until the request is
+  finished). Each worker thread writes to its own counters without locking; `Server::getMetrics()` adds them
+  up on demand.
+
+  If the library is built with `CEX_WITH_CHAIN_TIMING` (default, disable with `-DCEX_DISABLE_CHAIN_TIMING=ON`),
+  the time spent in each middleware function call and the number of candidates skipped because they did not
+  match are recorded per middleware, too. Candidates which did not match after the last called middleware of a
+  request are counted separately (`MetricsSnapshot::unmatched`).
+
+  ```
+   app.get("/metrics", cex::metricsHandler(&app), cex::Middleware::fMatchCompare);
+  ```
+*/
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <core.hpp>
+
+namespace cex
+{
+
+//***************************************************************************
+// class Histogram
+//***************************************************************************
+/*! \class Histogram
+  \brief Log-linear histogram (HDR style) of durations.
+
+  Values below 16 are counted exactly. Above, each power of two is split into 16 buckets, so a value is known
+  with a relative error of at most 1/16 (6.25%). Values beyond 2^36 (19 hours in microseconds) share the last bucket.
+  */
+
+class Histogram
+{
+   public:
+
+      enum
+      {
+         subBuckets=  16,
+         maxExponent= 36,
+         bucketCount= subBuckets + (maxExponent - 3) * subBuckets
+      };
+
+      Histogram() : counts(bucketCount, 0), total(0), sum(0) {}
+
+      /*! \brief Returns the bucket of a value */
+      static size_t bucketOf(uint64_t value);
+
+      /*! \brief Returns the smallest value of a bucket */
+      static uint64_t lowerBound(size_t bucket);
+
+      /*! \brief Returns the largest value of a bucket */
+      static uint64_t upperBound(size_t bucket);
+
+      /*! \brief Adds `count` occurrences of the values of a bucket, with the sum of the values */
+      void add(size_t bucket, uint64_t count, uint64_t valueSum);
+
+      /*! \brief Returns the number of values */
+      uint64_t count() const { return total; }
+
+      /*! \brief Returns the sum of all values */
+      uint64_t getSum() const { return sum; }
+
+      /*! \brief Returns the value below or at which the fraction `p` (0..1) of the values lies (largest value of its bucket) */
+      uint64_t percentile(double p) const;
+
+      /*! \brief Returns the number of values less than or equal to `value` (whole buckets only, so it may be smaller) */
+      uint64_t countUpTo(uint64_t value) const;
+
+   private:
+
+      std::vector<uint64_t> counts;
+      uint64_t total;
+      uint64_t sum;
+};
+
+//***************************************************************************
+// struct MetricsSnapshot
+//***************************************************************************
+/*! \struct MetricsSnapshot
+  \brief Metrics of a server, added up from all worker threads (see `Server::getMetrics()`) */
+
+struct MetricsSnapshot
+{
+   /*! \brief Latency of the requests handled by the middlewares of a path */
+   struct Route
+   {
+      std::string path;     /*!< \brief Path of the last middleware with a path the request was passed to, `*` if there was none */
+      Histogram latency;    /*!< \brief Microseconds from receiving the request headers until the request was finished */
+   };
+
+   /*! \brief Time spent in the function of a single middleware (see `CEX_WITH_CHAIN_TIMING`) */
+   struct MiddlewareTiming
+   {
+      MiddlewareTiming() : index(0), skipped(0) {}
+
+      size_t index;         /*!< \brief Index of the middleware, in the order the middlewares were attached */
+      std::string path;     /*!< \brief Path of the middleware (empty for general middlewares) */
+      Histogram duration;   /*!< \brief Nanoseconds per call of the middleware function (its count is the number of calls) */
+      uint64_t skipped;     /*!< \brief Candidates which did not match, evaluated before this middleware was called */
+   };
+
+   MetricsSnapshot() : requests(0), bytesIn(0), bytesOut(0), compressedIn(0), compressedOut(0), connections(0), unmatched(0) {}
+
+   uint64_t requests;       /*!< \brief Finished requests */
+   uint64_t bytesIn;        /*!< \brief Received request body bytes */
+   uint64_t bytesOut;       /*!< \brief Sent response body bytes (after compression) */
+   uint64_t compressedIn;   /*!< \brief Response body bytes passed to compression */
+   uint64_t compressedOut;  /*!< \brief Compressed bytes produced from `compressedIn` */
+   uint64_t connections;    /*!< \brief Currently open connections */
+   uint64_t unmatched;      /*!< \brief Candidates which did not match, evaluated after the last called middleware (see `CEX_WITH_CHAIN_TIMING`) */
+
+   std::vector<std::pair<int, uint64_t>> statusCodes;   /*!< \brief Number of responses per HTTP status code (sorted by code) */
+   std::vector<Route> routes;                           /*!< \brief Latency per middleware path */
+   std::vector<MiddlewareTiming> middlewares;           /*!< \brief Time per middleware function (only middlewares which were called) */
+
+   /*! \brief Returns `compressedIn / compressedOut`, or 0 if nothing was compressed */
+   double compressionRatio() const { return compressedOut ? (double)compressedIn / compressedOut : 0.0; }
+
+   /*! \brief Returns the metrics in the Prometheus text exposition format */
+   std::string prometheus() const;
+};
+
+//***************************************************************************
+// class Metrics
+//***************************************************************************
+/*! \class Metrics
+  \brief Metrics collector of a server.
+
+  Each thread recording metrics gets its own shard of counters, which only this thread writes (plain relaxed
+  stores, no locks, no atomic read-modify-write). `snapshot()` reads all shards and adds them up.
+  */
+
+class Metrics
+{
+   public:
+
+      /*! \brief Counters of a shard */
+      enum Counter
+      {
+         mcRequests,
+         mcBytesIn,
+         mcBytesOut,
+         mcCompressedIn,
+         mcCompressedOut,
+         mcConnectionsOpened,
+         mcConnectionsClosed,
+         mcUnmatched,
+
+         mcCount
+      };
+
+      /*! \brief Constructs a collector
+        \param routes The route paths (index 0 should be the route of requests without a path)
+        \param middlewares The paths of the server's middlewares (for the per-middleware timing) */
+      explicit Metrics(const std::vector<std::string>& routes, const std::vector<std::string>& middlewares= std::vector<std::string>());
+      ~Metrics();
+
+      Metrics(const Metrics&)= delete;
+      Metrics& operator=(const Metrics&)= delete;
+
+      /*! \brief Adds `value` to a counter of the calling thread */
+      void add(Counter counter, uint64_t value= 1) { increment(shard()->counters[counter], value); }
+
+      /*! \brief Counts a response with the given HTTP status code */
+      void addStatus(int status) { increment(shard()->statusCodes[status >= 100 && status < 600 ? status : 0], 1); }
+
+      /*! \brief Adds a request latency (microseconds) to the histogram of a route */
+      void addLatency(size_t route, uint64_t micros);
+
+      /*! \brief Adds the duration (nanoseconds) of a middleware function call */
+      void addMiddlewareTime(size_t ware, uint64_t nanos);
+
+      /*! \brief Adds `count` candidates skipped before a middleware was called */
+      void addSkipped(size_t ware, uint64_t count);
+
+      /*! \brief Adds up the shards of all threads */
+      MetricsSnapshot snapshot();
+
+   private:
+
+      struct HistogramShard
+      {
+         HistogramShard();
+
+         std::atomic<uint64_t> buckets[Histogram::bucketCount];
+         std::atomic<uint64_t> sum;
+         std::atomic<uint64_t> skipped;    // middlewares only
+      };
+
+      struct Shard
+      {
+         Shard(size_t routeCount, size_t wareCount);
+         ~Shard();
+
+         std::atomic<uint64_t> counters[mcCount];
+         std::atomic<uint64_t> statusCodes[600];                 // by code, 0: invalid codes
+         std::unique_ptr<std::atomic<HistogramShard*>[]> routes;   // allocated on first use
+         std::unique_ptr<std::atomic<HistogramShard*>[]> wares;    // allocated on first use
+         size_t routeCount;
+         size_t wareCount;
+      };
+
+      static void increment(std::atomic<uint64_t>& value, uint64_t n)
+      {
+         value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+      }
+
+      Shard* shard();
+      Shard* addShard();
+
+      static HistogramShard* histogramShard(std::atomic<HistogramShard*>& slot);
+      static void addHistogram(Histogram& histogram, HistogramShard* shard);
+
+      std::vector<std::string> routes;
+      std::vector<std::string> wares;
+      std::vector<std::unique_ptr<Shard>> shards;
+      std::mutex mutex;     // shards
+      uint64_t id;          // tells the thread-local shard caches of different collectors apart
+};
+
+//***************************************************************************
+// Middlewares
+//***************************************************************************
+// metricsHandler
+//***************************************************************************
+
+/*! \public
+  \brief Creates a middleware that replies with the metrics of `server` in the Prometheus text format (see `Server::getMetrics()`)
+ */
+
+MiddlewareFunction metricsHandler(Server* server);
+
+//***************************************************************************
+} // namespace cex
+
+#endif // __METRICS_HPP_
@@ -130,6 +130,9 @@ class PropertyList
       /*! \brief Removes a key from the list and returns the number of elements removed (0 or 1) */
       size_t remove(std::string key) { return entries.erase(key); }
 
+      /*! \brief Removes all keys from the list */
+      void clear() { entries.clear(); }
+
    private:
 
       std::unordered_map<std::string, std::shared_ptr<Property>> entries;
@@ -0,0 +1,141 @@
+//*************************************************************************
+// File regex.hpp
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// Class Regex
+//*************************************************************************
+
+#ifndef __REGEX_HPP__
+#define __REGEX_HPP__
+
+/*! \file regex.hpp
+  \brief Linear-time regular expression matcher used for `fMatchRegex` routes
+*/
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace cex
+{
+
+//***************************************************************************
+// class Regex
+//***************************************************************************
+/*! \class Regex
+  \brief Automaton based (non-backtracking) regular expression search.
+
+  Patterns are compiled into a Thompson NFA, which is converted into a DFA up front (as long as the
+  number of DFA states stays within a limit; otherwise the NFA is simulated directly). Either way, a search
+  takes time linear in the length of the input, and the compiled object is read-only, so it can be shared by
+  all worker threads.
+
+  Supports the ECMAScript subset commonly used in routes: literals, `.`, character classes (incl. ranges,
+  negation and `\\d \\w \\s \\D \\W \\S`), groups `( )` / `(?: )`, alternation, the quantifiers `* + ? {n} {n,} {n,m}`
+  (lazy variants behave the same, since only the existence of a match is checked) and the anchors `^` / `$`.
+  Backreferences, lookaheads, word boundaries and POSIX classes are not supported; `compile()` returns
+  `false` for such patterns.
+
+  Several patterns can be compiled into a single automaton, so one scan of the input decides which of the
+  patterns match.
+  */
+
+class Regex
+{
+   public:
+
+      Regex() : patternCount(0), classCount(0), valid(false) {}
+
+      /*! \brief Compiles a single pattern. Returns `false` if the pattern is invalid or unsupported. */
+      bool compile(const char* pattern);
+
+      /*! \brief Compiles several patterns into one automaton. The pattern index is used as match id.
+        Returns `false` if any of the patterns is invalid or unsupported. */
+      bool compile(const std::vector<std::string>& patterns);
+
+      /*! \brief Returns `true` if the last compile() was successful */
+      bool isValid() const { return valid; }
+
+      /*! \brief Returns the number of compiled patterns */
+      size_t size() const { return patternCount; }
+
+      /*! \brief Returns `true` if any of the patterns matches somewhere within `str` (like `std::regex_search`) */
+      bool search(const char* str) const;
+
+      /*! \brief Appends the ids of all patterns which match somewhere within `str` to `ids` (ascending, no duplicates) */
+      void search(const char* str, std::vector<int>& ids) const;
+
+   private:
+
+      struct CharSet
+      {
+         CharSet() { bits[0]= bits[1]= bits[2]= bits[3]= 0; }
+
+         bool has(unsigned char c) const { return (bits[c >> 6] >> (c & 63)) & 1; }
+         void add(unsigned char c) { bits[c >> 6] |= (uint64_t)1 << (c & 63); }
+         void add(const CharSet& other) { for (int i= 0; i < 4; i++) bits[i] |= other.bits[i]; }
+         void invert() { for (int i= 0; i < 4; i++) bits[i]= ~bits[i]; }
+
+         uint64_t bits[4];
+      };
+
+      enum NodeType
+      {
+         ndChar,     // consumes one character of `set`
+         ndSplit,    // epsilon to out and out1
+         ndBegin,    // epsilon to out, at the beginning of the input only
+         ndEnd,      // epsilon to out, at the end of the input only
+         ndMatch     // pattern `id` matched
+      };
+
+      struct Node
+      {
+         Node(int type= ndSplit, int out= na(), int out1= na()) : type(type), out(out), out1(out1), id(0) {}
+
+         int type;
+         int out;
+         int out1;
+         int id;
+         CharSet set;
+      };
+
+      struct State
+      {
+         std::vector<int> nodes;       // sorted NFA nodes (ndChar, ndEnd, ndMatch only)
+         std::vector<int> matches;     // pattern ids matched in this state
+         std::vector<int> endMatches;  // pattern ids matched if the input ends in this state
+      };
+
+      struct Ast;
+      friend struct Parser;
+
+      static int na() { return -1; }
+
+      int build(const Ast* ast, int next);
+      void closure(std::vector<int>& set, int node, bool atStart, bool atEnd, std::vector<char>& seen) const;
+      void closure(std::vector<int>& set, const std::vector<int>& from, bool atStart, bool atEnd) const;
+      void step(const std::vector<int>& from, unsigned char c, std::vector<int>& to) const;
+      void collect(const std::vector<int>& set, bool atStart, std::vector<int>& matches, std::vector<int>& endMatches) const;
+      void buildDfa();
+      void simulate(const char* str, std::vector<int>* ids, bool& any) const;
+
+      std::vector<Node> nodes;
+      std::vector<int> starts;         // start node per pattern
+      size_t patternCount;
+
+      std::vector<State> states;       // DFA; states[0] is the initial state
+      std::vector<int> table;          // DFA transitions: states * classCount
+      unsigned char classes[256];      // byte equivalence classes
+      int classCount;
+      bool valid;
+};
+
+//***************************************************************************
+} // namespace cex
+
+#endif // __REGEX_HPP_
@@ -20,11 +20,15 @@
 #include <vector>
 #include <functional>
 
+#include <cex/cex_config.h>
+
 struct evbuffer;
 
 namespace cex
 {
 
+struct CompressionOptions;
+
 //***************************************************************************
 // Definitions
 //***************************************************************************
@@ -34,7 +38,11 @@ enum CompressionMode
    cmUnknown= -1,
 
    cmDeflate,
-   cmGZip
+   cmGZip,
+   cmBrotli,
+   cmZstd,
+
+   cmCount
 };
 
 //***************************************************************************
@@ -44,9 +52,50 @@ enum CompressionMode
 std::vector<std::string> splitString(const char* str, char delim = ',', int trim = 1);
 std::string randomStringHex(int len);
 
-#ifdef CEX_WITH_ZLIB
-int compress(const char* src, size_t srcLen, struct evbuffer* dest, CompressionMode compMode= cmGZip);
-int compress(std::istream* stream, std::function<void(char*,size_t)> onChunk, CompressionMode compMode);
+/* decodes `srcLen` base64 characters into `dest`, which must hold base64DecodedSize(srcLen) bytes.
+   the result is null-terminated, returns its length */
+
+size_t base64DecodedSize(size_t srcLen);
+size_t base64Decode(const char* src, size_t srcLen, char* dest);
+CompressionMode negotiateCompression(const char* acceptEncoding);
+CompressionMode compressionMode(int responseFlags);
+const char* compressionEncoding(CompressionMode compMode);
+
+#ifdef CEX_WITH_COMPRESSION
+int compress(const char* src, size_t srcLen, struct evbuffer* dest, CompressionMode compMode= cmGZip, const CompressionOptions* opts= nullptr);
+int compress(std::istream* stream, std::function<void(char*,size_t)> onChunk, CompressionMode compMode, const CompressionOptions* opts= nullptr);
+
+//***************************************************************************
+// class Compressor
+//***************************************************************************
+// incremental compression with one of the available encodings. the encoder
+// state is taken from a per-thread pool where possible, and returned by the dtor
+
+class Compressor
+{
+   public:
+
+      Compressor(CompressionMode compMode, const CompressionOptions* opts= nullptr);
+      ~Compressor();
+
+      Compressor(const Compressor&)= delete;
+      Compressor& operator=(const Compressor&)= delete;
+
+      /* false if the encoding is not available or could not be initialized */
+
+      bool valid() const { return state != nullptr; }
+
+      /* compresses `len` bytes and passes the output to `onChunk` (possibly several times,
+         or not at all). `finish` ends the compressed stream. returns done or fail */
+
+      int write(const char* data, size_t len, bool finish, const std::function<void(char*,size_t)>& onChunk);
+
+   private:
+
+      CompressionMode mode;
+      void* state;
+      bool failed;
+};
 #endif
 
 static inline void lTrim(std::string &s) 
@@ -0,0 +1,139 @@
+//*************************************************************************
+// File arena.cc
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// cex Library Arena class implementation
+//*************************************************************************
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cex/arena.hpp>
+
+namespace cex
+{
+
+//***************************************************************************
+// class Arena
+//***************************************************************************
+// dtor
+//***************************************************************************
+
+Arena::~Arena()
+{
+   while (blocks)
+   {
+      Block* next= blocks->next;
+      ::free(blocks);
+      blocks= next;
+   }
+}
+
+//***************************************************************************
+// grow (allocate from a new block)
+//***************************************************************************
+
+void* Arena::grow(size_t size, size_t align)
+{
+   size_t needed= size + align - 1;
+
+   // large allocations get a block of their own, so the rest of the current block
+   // can still be used
+
+   if (needed > CEX_ARENA_BLOCK_SIZE / 4)
+   {
+      Block* block= (Block*)::malloc(sizeof(Block) + needed);
+
+      if (!block)
+         throw std::bad_alloc();
+
+      block->size= needed;
+
+      if (blocks)
+      {
+         block->next= blocks->next;
+         blocks->next= block;
+      }
+      else
+      {
+         block->next= nullptr;
+         blocks= block;
+      }
+
+      return (void*)(((uintptr_t)data(block) + align-1) & ~(uintptr_t)(align-1));
+   }
+
+   Block* block= (Block*)::malloc(sizeof(Block) + CEX_ARENA_BLOCK_SIZE);
+
+   if (!block)
+      throw std::bad_alloc();
+
+   block->size= CEX_ARENA_BLOCK_SIZE;
+   block->next= blocks;
+   blocks= block;
+
+   if (!first)
+      first= block;
+
+   ptr= data(block);
+   end= ptr + block->size;
+
+   return alloc(size, align);
+}
+
+//***************************************************************************
+// strdup
+//***************************************************************************
+
+char* Arena::strdup(const char* str)
+{
+   return str ? strndup(str, strlen(str)) : nullptr;
+}
+
+char* Arena::strndup(const char* str, size_t len)
+{
+   char* res= (char*)alloc(len + 1, 1);
+
+   memcpy(res, str, len);
+   res[len]= 0;
+
+   return res;
+}
+
+//***************************************************************************
+// reset
+//***************************************************************************
+
+void Arena::reset()
+{
+   while (blocks)
+   {
+      Block* next= blocks->next;
+
+      if (blocks != first)
+         ::free(blocks);
+
+      blocks= next;
+   }
+
+   if (first)
+   {
+      first->next= nullptr;
+      blocks= first;
+      ptr= data(first);
+      end= ptr + first->size;
+   }
+   else
+   {
+      ptr= end= nullptr;
+   }
+}
+
+//***************************************************************************
+} // namespace cex
@@ -11,22 +11,11 @@
 //***************************************************************************
 
 #include <cex/basicauth.hpp>
-#include <cex/util.hpp>   // splitString
+#include <cex/util.hpp>
 
 namespace cex
 {
 
-static const int B64index[256] = 
-{ 
-   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 62, 63, 62, 62, 63, 52, 53, 54, 55,
-   56, 57, 58, 59, 60, 61,  0,  0,  0,  0,  0,  0,  0,  0,  1,  2,  3,  4,  5,  6,
-   7,  8,  9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,  0,
-   0,  0,  0, 63,  0, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
-   41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51 
-};
-
 //***************************************************************************
 // Middleware basicAuth
 //***************************************************************************
@@ -43,46 +32,27 @@ MiddlewareFunction basicAuth()
          return;
       }
 
-      // decode base64 value (credits: https://stackoverflow.com/questions/342409/how-do-i-base64-encode-decode-in-c/41094722#41094722)
+      // decode base64 value. the decoded value is only needed temporarily, so it lives in the request's arena
 
       size_t len= strlen(authenticationHeader + 6);
-      unsigned char* p = (unsigned char*)authenticationHeader + 6;
-      int pad = len > 0 && (len % 4 || p[len - 1] == '=');
-      const size_t L = ((len + 3) / 4 - pad) * 4;
-      std::string str(L / 4 * 3 + pad, '\0');
-
-      for (size_t i = 0, j = 0; i < L; i += 4)
-      {
-         int n = B64index[p[i]] << 18 | B64index[p[i + 1]] << 12 | B64index[p[i + 2]] << 6 | B64index[p[i + 3]];
-         str[j++] = n >> 16;
-         str[j++] = n >> 8 & 0xFF;
-         str[j++] = n & 0xFF;
-      }
-
-      if (pad)
-      {
-         int n = B64index[p[L]] << 18 | B64index[p[L + 1]] << 12;
-         str[str.size() - 1] = n >> 16;
-
-         if (len > L + 2 && p[L + 2] != '=')
-         {
-            n |= B64index[p[L + 2]] << 6;
-            str.push_back(n >> 8 & 0xFF);
-         }
-      }
+      char* str = (char*)req->arena().alloc(base64DecodedSize(len), 1);
+      size_t strLen= base64Decode(authenticationHeader + 6, len, str);
 
       // split the decoded value by ':' and save it in request plist
 
-      if (str.length())
+      if (strLen)
       {
-         std::vector<std::string> splitted= splitString(str.c_str(), ':', 0);
+         const char* colon = strchr(str, ':');
+         const char* end = colon ? strchr(colon + 1, ':') : nullptr;
+         std::string username(str, colon ? colon - str : strlen(str));
+
+         req->properties.set("basicUsername", username);
 
-         if (splitted.size())
+         if (colon)
          {
-            req->properties.set("basicUsername", splitted[0]);
+            std::string password(colon + 1, end ? end - colon - 1 : strlen(colon + 1));
 
-            if (splitted.size() > 1)
-               req->properties.set("basicPassword", splitted[1]);
+            req->properties.set("basicPassword", password);
          }
       }
 
@@ -0,0 +1,187 @@
+//*************************************************************************
+// File chain.cc
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// cex Library Chain/Next class implementation
+//*************************************************************************
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <cex/core.hpp>
+#include <cex/metrics.hpp>
+
+namespace cex
+{
+
+//***************************************************************************
+// class Next
+//***************************************************************************
+// operator()
+//***************************************************************************
+
+void Next::operator()() const
+{
+   if (chain)
+      chain->next();
+}
+
+//***************************************************************************
+// class Chain
+//***************************************************************************
+// start
+//***************************************************************************
+
+void Chain::start(const std::vector<std::unique_ptr<Middleware>>* wares, Request* req, Response* res, bool routed)
+{
+   this->wares= wares;
+   this->req= req;
+   this->res= res;
+   this->routed= routed;
+
+   pos= 0;
+   calledWare= routeWare= na;
+   depth= 0;
+   nested= 0;
+   pending= false;
+
+   next();
+}
+
+//***************************************************************************
+// next
+//***************************************************************************
+
+void Chain::next()
+{
+   // called from an offloaded middleware function: continue on the event loop, once it returned
+
+   if (Response::offloading && Response::offloading == res)
+   {
+      res->postOffloaded([this]() { next(); });
+      return;
+   }
+
+   // called from within a middleware function: the following middlewares run right away, so the
+   // code after next() sees their result. beyond CEX_MAX_CHAIN_DEPTH nested calls, the innermost
+   // loop below continues as soon as the function returns instead, so the stack stays bounded.
+
+   if (depth >= CEX_MAX_CHAIN_DEPTH)
+   {
+      pending= true;
+      return;
+   }
+
+   depth++;
+   pending= true;
+
+#ifdef CEX_WITH_CHAIN_TIMING
+   size_t skipped= 0;     // candidates which did not match, since the last called middleware
+#endif
+
+   while (pending)
+   {
+      pending= false;
+
+      while (pos < entries.size())
+      {
+         Router::Entry& entry= entries[pos++];
+         Middleware* ware= (*wares)[entry.index].get();
+
+         // only the candidates which could not be decided by the router's lookup tables
+         // need a Middleware::match() call
+
+         if (!routed || entry.verify)
+         {
+            entry.paramOffset= params.size();
+
+            if (!ware->match(req, &params))
+            {
+#ifdef CEX_WITH_CHAIN_TIMING
+               skipped++;
+#endif
+               continue;
+            }
+         }
+
+         // a middleware which called next() inline gets its path and parameters back afterwards.
+         // the values are looked up by offset, as `params` may still grow
+
+         std::string callerPath;
+         const std::vector<std::string>* callerNames= req->paramNames;
+         size_t callerOffset= req->paramOffset;
+
+         if (depth > 1)
+            callerPath= req->middlewarePath;
+
+         req->middlewarePath= ware->getPath();
+
+         calledWare= entry.index;
+
+         if (!req->middlewarePath.empty())
+            routeWare= entry.index;
+
+         req->paramNames= &ware->paramNames;
+         req->paramValues= &params;
+         req->paramOffset= entry.paramOffset;
+
+#ifdef CEX_WITH_CHAIN_TIMING
+         if (metrics && skipped)
+         {
+            metrics->addSkipped(calledWare, skipped);
+            skipped= 0;
+         }
+#endif
+
+         if ((ware->flags & Middleware::fOffload) && offload && offload(ware))
+            break;
+
+#ifdef CEX_WITH_CHAIN_TIMING
+         // only the function itself: the time of the middlewares it called with next() is subtracted
+
+         if (metrics)
+         {
+            int index= calledWare;
+            uint64_t outer= nested;
+            std::chrono::steady_clock::time_point begin= std::chrono::steady_clock::now();
+
+            nested= 0;
+
+            ware->func(req, res, Next(this));
+
+            uint64_t elapsed= std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+
+            metrics->addMiddlewareTime(index, elapsed > nested ? elapsed - nested : 0);
+            nested= outer + elapsed;
+         }
+         else
+#endif
+         ware->func(req, res, Next(this));
+
+         // (the outermost one keeps its values, e.g. for a deferred response)
+
+         if (depth > 1)
+         {
+            req->middlewarePath.swap(callerPath);
+            req->paramNames= callerNames;
+            req->paramOffset= callerOffset;
+         }
+
+         break;
+      }
+   }
+
+#ifdef CEX_WITH_CHAIN_TIMING
+   // the end of the chain was reached, no middleware to attribute the candidates to
+
+   if (metrics && skipped)
+      metrics->add(Metrics::mcUnmatched, skipped);
+#endif
+
+   depth--;
+}
+
+//***************************************************************************
+} // namespace cex
@@ -0,0 +1,208 @@
+//*************************************************************************
+// File deferred.cc
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// cex Library DeferredResponse class implementation
+//*************************************************************************
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <string.h>
+
+#include <cex/core.hpp>
+
+namespace cex
+{
+
+//***************************************************************************
+// class DeferredResponse
+//***************************************************************************
+// ctor/dtor
+//***************************************************************************
+
+DeferredResponse::DeferredResponse(Response* res, struct event_base* base)
+   : res(res), nextHandlerId(0), completed(false), cancelled(false)
+{
+   ev= event_new(base, -1, 0, DeferredResponse::onEvent, this);
+}
+
+DeferredResponse::~DeferredResponse()
+{
+   if (ev)
+      event_free(ev);
+}
+
+//***************************************************************************
+// end
+//***************************************************************************
+
+int DeferredResponse::end(const char* string, int status)
+{
+   if (!string)
+      return fail;
+
+   std::string copy(string);
+
+   return queue([copy, status](Response* res)
+   {
+      res->end(copy.c_str(), status);
+   }, true);
+}
+
+int DeferredResponse::end(const char* buffer, size_t bufLen, int status)
+{
+   if (!buffer)
+      return fail;
+
+   std::string copy(buffer, bufLen);
+
+   return queue([copy, status](Response* res)
+   {
+      res->end(copy.data(), copy.size(), status);
+   }, true);
+}
+
+int DeferredResponse::end(int status)
+{
+   return queue([status](Response* res)
+   {
+      res->end(status);
+   }, true);
+}
+
+//***************************************************************************
+// run
+//***************************************************************************
+
+int DeferredResponse::run(std::function<void(Response* res)> func)
+{
+   if (!func)
+      return fail;
+
+   return queue(std::move(func), false);
+}
+
+//***************************************************************************
+// isCancelled
+//***************************************************************************
+
+bool DeferredResponse::isCancelled()
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   return cancelled;
+}
+
+//***************************************************************************
+// addCancelHandler/removeCancelHandler (worker thread)
+//***************************************************************************
+
+unsigned int DeferredResponse::addCancelHandler(std::function<void()> func)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   cancelHandlers.push_back(std::make_pair(++nextHandlerId, std::move(func)));
+
+   return nextHandlerId;
+}
+
+void DeferredResponse::removeCancelHandler(unsigned int id)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   for (size_t i= 0; i < cancelHandlers.size(); i++)
+   {
+      if (cancelHandlers[i].first == id)
+      {
+         cancelHandlers.erase(cancelHandlers.begin() + i);
+         break;
+      }
+   }
+}
+
+//***************************************************************************
+// getEventBase
+//***************************************************************************
+
+struct event_base* DeferredResponse::getEventBase()
+{
+   return ev ? event_get_base(ev) : nullptr;
+}
+
+//***************************************************************************
+// queue (any thread)
+//***************************************************************************
+
+int DeferredResponse::queue(std::function<void(Response* res)> func, bool last)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   if (completed || cancelled || !ev)
+      return fail;
+
+   completed= last;
+   pending.push_back(std::move(func));
+
+   // the first queued function activates the event, the following ones are picked up
+   // by the same callback. the handle stays alive until the callback has run.
+
+   if (!self)
+   {
+      self= shared_from_this();
+      event_active(ev, EV_READ, 0);
+   }
+
+   return done;
+}
+
+//***************************************************************************
+// cancel (worker thread, request finished)
+//***************************************************************************
+
+void DeferredResponse::cancel()
+{
+   std::vector<std::pair<unsigned int, std::function<void()>>> handlers;
+
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      cancelled= true;
+      res= nullptr;
+      handlers.swap(cancelHandlers);
+   }
+
+   // handlers may remove themselves (or others) meanwhile, which is harmless now
+
+   for (size_t i= 0; i < handlers.size(); i++)
+      handlers[i].second();
+}
+
+//***************************************************************************
+// onEvent (worker thread)
+//***************************************************************************
+
+void DeferredResponse::onEvent(evutil_socket_t fd, short what, void* arg)
+{
+   DeferredResponse* handle= (DeferredResponse*)arg;
+   std::shared_ptr<DeferredResponse> keep;
+   std::vector<std::function<void(Response* res)>> funcs;
+
+   {
+      std::lock_guard<std::mutex> lock(handle->mutex);
+
+      keep.swap(handle->self);
+      funcs.swap(handle->pending);
+   }
+
+   // the request may finish while the functions run (or the client is already gone),
+   // which resets handle->res
+
+   for (size_t i= 0; i < funcs.size() && handle->res; i++)
+      funcs[i](handle->res);
+}
+
+//***************************************************************************
+} // namespace cex
@@ -0,0 +1,165 @@
+//*************************************************************************
+// File executor.cc
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// cex Library Executor class implementation
+//*************************************************************************
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <executor.hpp>
+
+namespace cex
+{
+
+//***************************************************************************
+// statics
+//***************************************************************************
+
+// the executor and queue index of the calling thread, if it belongs to a pool
+
+static thread_local Executor* currentExecutor= nullptr;
+static thread_local size_t currentIndex= 0;
+
+//***************************************************************************
+// class Executor
+//***************************************************************************
+// ctor/dtor
+//***************************************************************************
+
+Executor::Executor(unsigned int threads)
+   : queued(0), stopping(false), nextWorker(0)
+{
+   if (!threads)
+      threads= std::thread::hardware_concurrency();
+
+   if (!threads)
+      threads= 1;
+
+   // all queues must exist before the first thread may steal from them
+
+   for (unsigned int i= 0; i < threads; i++)
+      workers.push_back(std::unique_ptr<Worker>(new Worker));
+
+   for (size_t i= 0; i < workers.size(); i++)
+      workers[i]->thread= std::thread(&Executor::run, this, i);
+}
+
+Executor::~Executor()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping= true;
+   }
+
+   cond.notify_all();
+
+   for (size_t i= 0; i < workers.size(); i++)
+      workers[i]->thread.join();
+}
+
+//***************************************************************************
+// submit
+//***************************************************************************
+
+void Executor::submit(std::function<void()> job)
+{
+   // counted before it is published, so the thread taking it can't decrement the counter first
+
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      queued++;
+   }
+
+   if (currentExecutor == this)
+   {
+      Worker* worker= workers[currentIndex].get();
+      std::lock_guard<std::mutex> lock(worker->mutex);
+
+      worker->jobs.push_front(std::move(job));
+   }
+   else
+   {
+      Worker* worker= workers[nextWorker++ % workers.size()].get();
+      std::lock_guard<std::mutex> lock(worker->mutex);
+
+      worker->jobs.push_back(std::move(job));
+   }
+
+   cond.notify_one();
+}
+
+//***************************************************************************
+// take (own queue first, then steal)
+//***************************************************************************
+
+bool Executor::take(size_t index, std::function<void()>& job)
+{
+   for (size_t i= 0; i < workers.size(); i++)
+   {
+      Worker* worker= workers[(index + i) % workers.size()].get();
+      std::lock_guard<std::mutex> lock(worker->mutex);
+
+      if (worker->jobs.empty())
+         continue;
+
+      if (!i)
+      {
+         job= std::move(worker->jobs.front());
+         worker->jobs.pop_front();
+      }
+      else
+      {
+         job= std::move(worker->jobs.back());
+         worker->jobs.pop_back();
+      }
+
+      return true;
+   }
+
+   return false;
+}
+
+//***************************************************************************
+// run (pool thread)
+//***************************************************************************
+
+void Executor::run(size_t index)
+{
+   currentExecutor= this;
+   currentIndex= index;
+
+   while (true)
+   {
+      std::function<void()> job;
+
+      if (take(index, job))
+      {
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued--;
+         }
+
+         job();
+         continue;
+      }
+
+      // a job is counted from before it is queued until after it was taken, so a
+      // count without a job (being queued, or taken by another thread) just causes another round
+
+      std::unique_lock<std::mutex> lock(mutex);
+
+      cond.wait(lock, [this]() { return queued > 0 || stopping; });
+
+      if (stopping && !queued)
+         break;
+   }
+
+   currentExecutor= nullptr;
+}
+
+//***************************************************************************
+} // namespace cex
@@ -12,14 +12,750 @@
 //***************************************************************************
 
 #include <cex/filesystem.hpp>
+#include <cex/util.hpp>
 
+#include <chrono>
 #include <fstream>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 #include <errno.h>
 #include <ctype.h>
+#include <strings.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define CEX_MAX_RANGES 16     // requests with more ranges get the whole file
 
 namespace cex
 {
 
+//***************************************************************************
+// class FileCache
+//***************************************************************************
+/* File contents, keyed by the resolved path, with LRU eviction. Compressed
+   representations are keyed by path + encoding. The contents are read into
+   memory once (a mapping would fault with SIGBUS if the file was truncated
+   meanwhile). Entries are reference counted: an evicted/outdated entry stays
+   valid until the last response referencing it was sent. */
+
+class FileCache
+{
+   public:
+
+      struct Entry
+      {
+         Entry() : data(nullptr), size(0), fileSize(0), mtime(0), ino(0) {}
+         ~Entry() { free(data); }
+
+         bool matches(const struct stat& st) const { return st.st_mtime == mtime && (size_t)st.st_size == fileSize && st.st_ino == ino; }
+
+         void* data;
+         size_t size;
+         size_t fileSize;   // of the file (size differs for compressed entries)
+         time_t mtime;
+         ino_t ino;
+      };
+
+      typedef std::shared_ptr<Entry> EntryPtr;
+
+      explicit FileCache(FilesystemOptions* opts) : opts(opts), totalBytes(0) {}
+
+      /* returns the contents of `path` (mode cmUnknown), or its compressed representation (compressed with `compression`).
+         `st` is the caller's stat() of the file: the contents always belong to this version of the file (so they
+         match the validators built from it), nullptr if the file was modified meanwhile */
+
+      EntryPtr get(const std::string& path, const struct stat& st, CompressionMode mode= cmUnknown, const CompressionOptions* compression= nullptr);
+
+   private:
+
+      struct Slot
+      {
+         EntryPtr entry;
+         std::list<std::string>::iterator lru;
+      };
+
+      EntryPtr load(const std::string& path, const std::string& key, const struct stat& expected, CompressionMode mode, const CompressionOptions* compression);
+      void remove(const std::string& key, const EntryPtr& entry);
+
+      FilesystemOptions* opts;
+      std::mutex mutex;
+      std::unordered_map<std::string, Slot> entries;
+      std::list<std::string> lru;       // most recently used first
+      size_t totalBytes;
+};
+
+//***************************************************************************
+// get (cached contents, loaded if needed. nullptr if the file can't be cached)
+//***************************************************************************
+
+FileCache::EntryPtr FileCache::get(const std::string& path, const struct stat& st, CompressionMode mode, const CompressionOptions* compression)
+{
+   EntryPtr entry;
+
+   // a NUL byte can't be part of a path, so it separates path and encoding
+
+   std::string key(path);
+
+   if (mode != cmUnknown)
+   {
+      key.push_back('\0');
+      key.push_back('0' + mode);
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::unordered_map<std::string, Slot>::iterator it= entries.find(key);
+
+      if (it != entries.end())
+      {
+         entry= it->second.entry;
+         lru.splice(lru.begin(), lru, it->second.lru);
+      }
+   }
+
+   if (entry && entry->matches(st))
+      return entry;
+
+   // outdated: the new version is loaded (unless it was modified again meanwhile)
+
+   if (entry)
+      remove(key, entry);
+
+   return load(path, key, st, mode, compression);
+}
+
+//***************************************************************************
+// load
+//***************************************************************************
+
+FileCache::EntryPtr FileCache::load(const std::string& path, const std::string& key, const struct stat& expected, CompressionMode mode, const CompressionOptions* compression)
+{
+   struct stat st;
+   int fd= ::open(path.c_str(), O_RDONLY|O_CLOEXEC);
+
+   if (fd < 0)
+      return nullptr;
+
+   if (fstat(fd, &st) || !S_ISREG(st.st_mode) || (size_t)st.st_size > opts->cacheMaxFileSize || (size_t)st.st_size > opts->cacheMaxBytes)
+   {
+      ::close(fd);
+      return nullptr;
+   }
+
+   EntryPtr entry(new Entry());
+
+   entry->size= entry->fileSize= st.st_size;
+   entry->mtime= st.st_mtime;
+   entry->ino= st.st_ino;
+
+   if (!entry->matches(expected))
+   {
+      ::close(fd);
+      return nullptr;
+   }
+
+   entry->data= malloc(entry->size ? entry->size : 1);
+
+   if (!entry->data)
+   {
+      ::close(fd);
+      return nullptr;
+   }
+
+   size_t offset= 0;
+
+   while (offset < entry->size)
+   {
+      ssize_t count= pread(fd, (char*)entry->data + offset, entry->size - offset, offset);
+
+      if (count <= 0)
+         break;
+
+      offset+= count;
+   }
+
+   // modified while reading (truncated, or written to in place)
+
+   if (offset != entry->size || fstat(fd, &st) || !entry->matches(st))
+   {
+      ::close(fd);
+      return nullptr;
+   }
+
+   ::close(fd);
+
+   // compressed representation: compress once, keep the result instead of the contents
+
+   if (mode != cmUnknown)
+   {
+#ifdef CEX_WITH_COMPRESSION
+      struct evbuffer* compressed= evbuffer_new();
+      size_t size= 0;
+      void* data= nullptr;
+
+      // with the configured levels: this runs on the event loop, which the highest levels would block for long
+
+      if (compressed && compress((const char*)entry->data, entry->size, compressed, mode, compression) == done)
+      {
+         size= evbuffer_get_length(compressed);
+         data= malloc(size ? size : 1);
+
+         if (data)
+            evbuffer_copyout(compressed, data, size);
+      }
+
+      if (compressed)
+         evbuffer_free(compressed);
+
+      if (!data)
+         return nullptr;
+
+      free(entry->data);
+
+      entry->data= data;
+      entry->size= size;
+#else
+      return nullptr;
+#endif
+   }
+
+   // insert, evict least recently used entries if over the limits
+
+   std::lock_guard<std::mutex> lock(mutex);
+   std::unordered_map<std::string, Slot>::iterator it= entries.find(key);
+
+   if (it != entries.end())
+   {
+      // loaded concurrently by another thread
+
+      totalBytes -= it->second.entry->size;
+      lru.erase(it->second.lru);
+      entries.erase(it);
+   }
+
+   while (!lru.empty() && (totalBytes + entry->size > opts->cacheMaxBytes || entries.size() >= opts->cacheMaxEntries))
+   {
+      std::unordered_map<std::string, Slot>::iterator last= entries.find(lru.back());
+
+      totalBytes -= last->second.entry->size;
+      entries.erase(last);
+      lru.pop_back();
+   }
+
+   lru.push_front(key);
+
+   Slot& slot= entries[key];
+   slot.entry= entry;
+   slot.lru= lru.begin();
+   totalBytes += entry->size;
+
+   return entry;
+}
+
+//***************************************************************************
+// remove (outdated entry, unless it was replaced already)
+//***************************************************************************
+
+void FileCache::remove(const std::string& key, const EntryPtr& entry)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   std::unordered_map<std::string, Slot>::iterator it= entries.find(key);
+
+   if (it == entries.end() || it->second.entry != entry)
+      return;
+
+   totalBytes -= entry->size;
+   lru.erase(it->second.lru);
+   entries.erase(it);
+}
+
+//***************************************************************************
+// sendCached (reply with a cached entry, without copying)
+//***************************************************************************
+
+struct SendBuffer
+{
+   SendBuffer() : buffer(evbuffer_new()) {}
+   ~SendBuffer() { evbuffer_free(buffer); }
+
+   struct evbuffer* buffer;
+};
+
+static void releaseEntry(const void* data, size_t len, void* arg)
+{
+   delete (FileCache::EntryPtr*)arg;
+}
+
+static int sendCached(Response* res, const FileCache::EntryPtr& entry, const char* encoding= nullptr)
+{
+   static thread_local SendBuffer sendBuffer;
+
+   if (encoding)
+      res->set("Content-Encoding", encoding);
+
+   if (entry->size)
+   {
+      // the reference keeps the contents alive until the data was written to the socket
+
+      FileCache::EntryPtr* ref= new FileCache::EntryPtr(entry);
+
+      if (evbuffer_add_reference(sendBuffer.buffer, entry->data, entry->size, releaseEntry, ref))
+      {
+         delete ref;
+         return fail;
+      }
+   }
+
+   int ret= res->end(sendBuffer.buffer, 200);
+
+   evbuffer_drain(sendBuffer.buffer, evbuffer_get_length(sendBuffer.buffer));
+
+   return ret;
+}
+
+//***************************************************************************
+// httpDate (IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT")
+//***************************************************************************
+
+static void httpDate(time_t t, char* buf)
+{
+   static const char* days[]= { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+   static const char* months[]= { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+   struct tm tm;
+
+   gmtime_r(&t, &tm);
+
+   sprintf(buf, "%s, %02d %s %04d %02d:%02d:%02d GMT", days[tm.tm_wday], tm.tm_mday, months[tm.tm_mon], 
+      tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+}
+
+//***************************************************************************
+// parseRange (Range header, RFC 7233)
+//***************************************************************************
+// returns 1 if `ranges` contains the satisfiable ranges, -1 if no range is
+// satisfiable (416), and 0 if the header shall be ignored (whole file)
+
+struct ByteRange
+{
+   size_t first;
+   size_t last;       // inclusive
+};
+
+static int parseRange(const char* header, size_t size, std::vector<ByteRange>& ranges)
+{
+   const char* p= header;
+   int specs= 0;
+
+   while (*p == ' ' || *p == '\t')
+      p++;
+
+   if (strncasecmp(p, "bytes=", 6))
+      return 0;
+
+   p += 6;
+
+   while (*p)
+   {
+      while (*p == ' ' || *p == '\t' || *p == ',')
+         p++;
+
+      if (!*p)
+         break;
+
+      char* end= nullptr;
+      ByteRange r;
+
+      if (*p == '-')
+      {
+         // suffix range (last N bytes)
+
+         if (!isdigit(p[1]))
+            return 0;
+
+         unsigned long long suffix= strtoull(p+1, &end, 10);
+
+         if (suffix && size)
+         {
+            r.first= suffix < size ? size - suffix : 0;
+            r.last= size - 1;
+            ranges.push_back(r);
+         }
+      }
+      else if (isdigit(*p))
+      {
+         unsigned long long first= strtoull(p, &end, 10), last= size ? size-1 : 0;
+
+         if (*end != '-')
+            return 0;
+
+         end++;
+
+         if (isdigit(*end))
+         {
+            last= strtoull(end, &end, 10);
+
+            if (last < first)
+               return 0;
+         }
+
+         if (first < size)
+         {
+            r.first= first;
+            r.last= last < size ? last : size - 1;
+            ranges.push_back(r);
+         }
+      }
+      else
+      {
+         return 0;
+      }
+
+      p= end;
+
+      while (*p == ' ' || *p == '\t')
+         p++;
+
+      if (*p && *p != ',')
+         return 0;
+
+      if (++specs > CEX_MAX_RANGES)
+         return 0;
+   }
+
+   if (!specs)
+      return 0;
+
+   return ranges.empty() ? -1 : 1;
+}
+
+//***************************************************************************
+// class HashCache
+//***************************************************************************
+/* Content hashes for strong ETags, computed once per version of a file */
+
+class HashCache
+{
+   public:
+
+      HashCache(size_t maxEntries, size_t maxFileSize) : maxEntries(maxEntries), maxFileSize(maxFileSize) {}
+
+      uint64_t get(const std::string& path, const struct stat& st);
+
+   private:
+
+      struct Item
+      {
+         time_t mtime;
+         off_t size;
+         ino_t ino;
+         uint64_t hash;
+         std::list<std::string>::iterator lru;
+      };
+
+      std::mutex mutex;
+      std::unordered_map<std::string, Item> items;
+      std::list<std::string> lru;       // most recently used first
+      size_t maxEntries;
+      size_t maxFileSize;
+};
+
+//***************************************************************************
+// get (0 if the file could not be read or is too large to be hashed)
+//***************************************************************************
+
+uint64_t HashCache::get(const std::string& path, const struct stat& st)
+{
+   // hashed on the event loop, so large files keep the stat() based ETag
+
+   if ((size_t)st.st_size > maxFileSize)
+      return 0;
+
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::unordered_map<std::string, Item>::iterator it= items.find(path);
+
+      if (it != items.end() && it->second.mtime == st.st_mtime && it->second.size == st.st_size && it->second.ino == st.st_ino)
+      {
+         lru.splice(lru.begin(), lru, it->second.lru);
+         return it->second.hash;
+      }
+   }
+
+   // FNV-1a (64 bit) over the file contents. read() instead of a mapping: a file
+   // truncated meanwhile just gives a short read (instead of SIGBUS)
+
+   uint64_t hash= 14695981039346656037ULL;
+   int fd= ::open(path.c_str(), O_RDONLY|O_CLOEXEC);
+   unsigned char buffer[16*1024];
+   off_t offset= 0;
+
+   if (fd < 0)
+      return 0;
+
+   while (offset < st.st_size)
+   {
+      ssize_t count= pread(fd, buffer, sizeof(buffer), offset);
+
+      if (count <= 0)
+         break;
+
+      for (ssize_t i= 0; i < count; i++)
+         hash= (hash ^ buffer[i]) * 1099511628211ULL;
+
+      offset+= count;
+   }
+
+   ::close(fd);
+
+   // modified while reading
+
+   if (offset != st.st_size)
+      return 0;
+
+   std::lock_guard<std::mutex> lock(mutex);
+   std::unordered_map<std::string, Item>::iterator it= items.find(path);
+
+   if (it != items.end())
+   {
+      lru.erase(it->second.lru);
+      items.erase(it);
+   }
+
+   while (!lru.empty() && items.size() >= maxEntries)
+   {
+      items.erase(lru.back());
+      lru.pop_back();
+   }
+
+   lru.push_front(path);
+
+   Item& item= items[path];
+
+   item.mtime= st.st_mtime;
+   item.size= st.st_size;
+   item.ino= st.st_ino;
+   item.hash= hash;
+   item.lru= lru.begin();
+
+   return hash;
+}
+
+//***************************************************************************
+// Validators (ETag, Last-Modified)
+//***************************************************************************
+
+struct Validators
+{
+   char etag[64];             // of the uncompressed contents
+   char lastModified[40];
+};
+
+static void makeValidators(const struct stat& st, uint64_t hash, Validators& validators)
+{
+   if (hash)
+      sprintf(validators.etag, "\"%016llx\"", (unsigned long long)hash);
+   else
+      sprintf(validators.etag, "\"%llx-%llx\"", (unsigned long long)st.st_mtime, (unsigned long long)st.st_size);
+
+   httpDate(st.st_mtime, validators.lastModified);
+}
+
+// ETag of an encoded representation: the uncompressed ETag with the encoding appended
+
+static std::string encodedETag(const char* etag, const char* encoding)
+{
+   std::string res(etag, strlen(etag) - 1);
+
+   res += "-";
+   res += encoding;
+   res += "\"";
+
+   return res;
+}
+
+//***************************************************************************
+// etagMatches (If-None-Match list, weak comparison)
+//***************************************************************************
+
+static bool etagMatches(const char* header, const std::string& etag)
+{
+   const char* p= header;
+   const char* tag= etag.c_str() + (etag.compare(0, 2, "W/") ? 0 : 2);
+   size_t tagLen= strlen(tag);
+
+   while (*p)
+   {
+      while (*p == ' ' || *p == '\t' || *p == ',')
+         p++;
+
+      if (*p == '*')
+         return true;
+
+      if (!strncmp(p, "W/", 2))
+         p += 2;
+
+      const char* end= p;
+
+      while (*end && *end != ',')
+         end++;
+
+      const char* last= end;
+
+      while (last > p && (last[-1] == ' ' || last[-1] == '\t'))
+         last--;
+
+      if ((size_t)(last - p) == tagLen && !strncmp(p, tag, tagLen))
+         return true;
+
+      p= end;
+   }
+
+   return false;
+}
+
+//***************************************************************************
+// notModified (If-None-Match / If-Modified-Since, RFC 7232)
+//***************************************************************************
+
+static bool notModified(Request* req, const struct stat& st, const std::string& etag)
+{
+   const char* ifNoneMatch= req->get("If-None-Match");
+
+   if (ifNoneMatch)
+      return etagMatches(ifNoneMatch, etag);
+
+   const char* ifModifiedSince= req->get("If-Modified-Since");
+
+   if (!ifModifiedSince)
+      return false;
+
+   struct tm tm;
+
+   memset(&tm, 0, sizeof(tm));
+
+   if (!strptime(ifModifiedSince, "%a, %d %b %Y %H:%M:%S GMT", &tm))
+      return false;
+
+   return st.st_mtime <= timegm(&tm);
+}
+
+//***************************************************************************
+// sendRanges (206 Partial Content, single range or multipart/byteranges)
+//***************************************************************************
+// returns false if the request shall be answered with the whole file
+
+static bool sendRanges(Request* req, Response* res, const std::string& path, const char* header, const std::string& cntType, const Validators& validators)
+{
+   struct stat st;
+   std::vector<ByteRange> ranges;
+   char value[100];
+
+   int fd= ::open(path.c_str(), O_RDONLY|O_CLOEXEC);
+
+   if (fd < 0 || fstat(fd, &st) || !S_ISREG(st.st_mode))
+   {
+      if (fd >= 0)
+         ::close(fd);
+
+      return false;
+   }
+
+   // If-Range: the ranges are only valid for the file's current version (strong comparison)
+
+   const char* ifRange= req->get("If-Range");
+
+   if (ifRange && strcmp(ifRange, *ifRange == '"' ? validators.etag : validators.lastModified))
+   {
+      ::close(fd);
+      return false;
+   }
+
+   int result= parseRange(header, st.st_size, ranges);
+
+   if (result <= 0)
+      ::close(fd);
+
+   if (!result)
+      return false;
+
+   res->set("ETag", validators.etag);
+
+   if (result < 0)
+   {
+      sprintf(value, "bytes */%llu", (unsigned long long)st.st_size);
+
+      res->set("Content-Range", value);
+      res->end(416);
+
+      return true;
+   }
+
+   res->set("Accept-Ranges", "bytes");
+
+   // (1) single range
+
+   if (ranges.size() == 1)
+   {
+      sprintf(value, "bytes %zu-%zu/%llu", ranges[0].first, ranges[0].last, (unsigned long long)st.st_size);
+
+      res->set("Content-Type", cntType.c_str());
+      res->set("Content-Range", value);
+
+      if (res->sendFile(206, fd, ranges[0].first, ranges[0].last - ranges[0].first + 1) != done)
+         res->end(500);
+
+      return true;
+   }
+
+   // (2) multiple ranges: each part gets its own header, the file contents are added
+   // as segments of the same file
+
+   std::string boundary= randomStringHex(16);
+   std::vector<std::string> partHeaders(ranges.size());
+   std::string trailer= "\r\n--" + boundary + "--\r\n";
+   size_t contentLength= trailer.size();
+
+   for (size_t i= 0; i < ranges.size(); i++)
+   {
+      sprintf(value, "bytes %zu-%zu/%llu", ranges[i].first, ranges[i].last, (unsigned long long)st.st_size);
+
+      partHeaders[i]= "\r\n--" + boundary + "\r\nContent-Type: " + cntType + "\r\nContent-Range: " + value + "\r\n\r\n";
+      contentLength += partHeaders[i].size() + ranges[i].last - ranges[i].first + 1;
+   }
+
+   struct evbuffer_file_segment* seg= evbuffer_file_segment_new(fd, 0, st.st_size, EVBUF_FS_CLOSE_ON_FREE);
+
+   if (!seg)
+   {
+      ::close(fd);
+      res->end(500);
+      return true;
+   }
+
+   std::string multipartType= "multipart/byteranges; boundary=" + boundary;
+
+   res->set("Content-Type", multipartType.c_str());
+
+   res->end(206, contentLength, [&](struct evbuffer* output)
+   {
+      for (size_t i= 0; i < ranges.size(); i++)
+      {
+         if (evbuffer_add(output, partHeaders[i].data(), partHeaders[i].size())
+            || evbuffer_add_file_segment(output, seg, ranges[i].first, ranges[i].last - ranges[i].first + 1))
+            return (int)fail;
+      }
+
+      return evbuffer_add(output, trailer.data(), trailer.size()) ? (int)fail : (int)done;
+   });
+
+   evbuffer_file_segment_free(seg);
+
+   return true;
+}
+
 //***************************************************************************
 // Middleware filesystem
 //***************************************************************************
@@ -42,7 +778,16 @@ MiddlewareFunction filesystem(std::shared_ptr<FilesystemOptions> opts)
    if (opts.get() && !opts.get()->rootPath.empty() && opts.get()->rootPath.back() != '/')
       opts.get()->rootPath.push_back('/');
 
-   MiddlewareFunction res = [opts](Request* req, Response* res, std::function<void()> next)
+   std::shared_ptr<FileCache> cache;
+   std::shared_ptr<HashCache> hashes;
+
+   if (opts.get() && opts.get()->cache)
+      cache.reset(new FileCache(opts.get()));
+
+   if (opts.get() && opts.get()->etagHash)
+      hashes.reset(new HashCache(opts.get()->cacheMaxEntries, opts.get()->etagHashMaxFileSize));
+
+   MiddlewareFunction res = [opts, cache, hashes](Request* req, Response* res, std::function<void()> next)
    {
       FilesystemOptions* theOpts = opts.get() ? opts.get() : &defaultOptions;
 
@@ -89,7 +834,7 @@ MiddlewareFunction filesystem(std::shared_ptr<FilesystemOptions> opts)
          p++;
       }
 
-      // (2) determine mime type & correctly set Content-Type header
+      // (2) determine mime type & Content-Type header
 
       p= req->getUrl() + strlen(req->getUrl()) - 1;
 
@@ -99,44 +844,167 @@ MiddlewareFunction filesystem(std::shared_ptr<FilesystemOptions> opts)
       if (*p == '.')
          extension= p+1;
 
+      std::string cntType;
+
       if (!extension.empty() && Server::getMimeTypes()->count(extension))
       {
          type= (*Server::getMimeTypes())[extension];
 
-         std::string cntType= type.first;
+         cntType= type.first;
 
          if (!type.second)
          {
             cntType+= "; charset=";
             cntType+= theOpts->defaultEncoding;
          }
-
-         res->set("Content-Type", cntType.c_str());
       }
       else
       {
-         std::string cntType= "text/plain; charset=";
+         cntType= "text/plain; charset=";
          cntType += theOpts->defaultEncoding;
+      }
+
+      // (3) validators. conditional requests are answered with 304 before the file is opened
+
+      struct stat st;
+      Validators validators;
+
+      if (stat(url.c_str(), &st) || !S_ISREG(st.st_mode))
+      {
+         res->end(404);
+         return;
+      }
+
+      makeValidators(st, hashes ? hashes.get()->get(url, st) : 0, validators);
+
+      CompressionMode mode= res->compressible(st.st_size, cntType.c_str()) ? compressionMode(res->getFlags()) : cmUnknown;
+      const char* encoding= compressionEncoding(mode);
+      std::string etag= mode == cmUnknown ? std::string(validators.etag) : encodedETag(validators.etag, encoding);
+
+      res->set("Last-Modified", validators.lastModified);
+
+      if (notModified(req, st, etag))
+      {
+         res->set("ETag", etag.c_str());
+         res->end(304);
+         return;
+      }
+
+      // (4) range requests (always uncompressed). sets its own Content-Type and ETag, if it replies
+
+      const char* range= req->get("Range");
+
+      if (range && sendRanges(req, res, url, range, cntType, validators))
+         return;
+
+      res->set("ETag", etag.c_str());
+      res->set("Content-Type", cntType.c_str());
+
+      // (5) uncompressed: send the file without copying it through user space (sendfile)
+
+      if (mode == cmUnknown)
+      {
+         // (5a) cached contents
+
+         if (cache)
+         {
+            FileCache::EntryPtr entry= cache.get()->get(url, st);
+
+            if (entry)
+            {
+               res->set("Accept-Ranges", "bytes");
+
+               if (sendCached(res, entry) != done)
+                  res->end(500);
+
+               return;
+            }
+         }
+
+         int fd= ::open(url.c_str(), O_RDONLY|O_CLOEXEC);
+
+         if (fd < 0 || fstat(fd, &st) || !S_ISREG(st.st_mode))
+         {
+            if (fd >= 0)
+               ::close(fd);
+
+            res->end(404);
+            return;
+         }
+
+         res->set("Accept-Ranges", "bytes");
+
+         if (res->sendFile(200, fd, 0, st.st_size) != done)
+            res->end(500);
 
-         res->set("Content-Type", cntType.c_str());
+         return;
+      }
+
+      // (6) compressed. (6a) sibling file with precompressed contents (e.g. `app.js.gz`), if it is up to date
+
+      static const char* siblingExtensions[cmCount]= { nullptr, ".gz", ".br", ".zst" };
+
+      if (siblingExtensions[mode] && theOpts->precompressed)
+      {
+         struct stat gzSt;
+         std::string gzUrl= url + siblingExtensions[mode];
+
+         if (!stat(gzUrl.c_str(), &gzSt) && S_ISREG(gzSt.st_mode) && gzSt.st_mtime >= st.st_mtime)
+         {
+            FileCache::EntryPtr entry= cache ? cache.get()->get(gzUrl, gzSt) : nullptr;
+
+            if (entry)
+            {
+               if (sendCached(res, entry, encoding) != done)
+                  res->end(500);
+
+               return;
+            }
+
+            int fd= ::open(gzUrl.c_str(), O_RDONLY|O_CLOEXEC);
+
+            if (fd >= 0)
+            {
+               res->set("Content-Encoding", encoding);
+
+               if (res->sendFile(200, fd, 0, gzSt.st_size) != done)
+                  res->end(500);
+
+               return;
+            }
+         }
+      }
+
+      // (6b) cached compressed representation (compressed once, on first access)
+
+      if (cache)
+      {
+         FileCache::EntryPtr entry= cache.get()->get(url, st, mode, &res->getCompressionOptions());
+
+         if (entry)
+         {
+            if (sendCached(res, entry, encoding) != done)
+               res->end(500);
+
+            return;
+         }
       }
 
-      // (3) open the file using ifstream
+      // (6c) compress while streaming the file
 
-      std::ifstream file(url.c_str(), std::ios::in|std::ios::binary);
+      std::unique_ptr<std::ifstream> file(new std::ifstream(url.c_str(), std::ios::in|std::ios::binary));
 
-      // (4a) respond 404 if file could not be found
+      // (6d) respond 404 if file could not be found
 
-      if (!file.is_open() || !file.good())
+      if (!file->is_open() || !file->good())
       {
          res->end(404);
          return;
       }
 
-      // (4b) reply with binary data using the stream interface (send chunks)
+      // (6e) reply with binary data using the stream interface (send chunks as the client receives them)
 
-      res->stream(200, &file);
-      file.close();
+      res->stream(200, std::move(file));
    };
 
    return res;
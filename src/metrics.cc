@@ -0,0 +1,538 @@
+//*************************************************************************
+// File metrics.cc
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// cex Library Metrics/Histogram class implementation, metricsHandler
+//*************************************************************************
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <stdio.h>
+#include <algorithm>
+
+#include <cex/metrics.hpp>
+
+#define CEX_METRICS_THREAD_SHARDS 16   // collectors a thread keeps its shard of (least recently used are forgotten)
+
+namespace cex
+{
+
+//***************************************************************************
+// statics
+//***************************************************************************
+
+static std::atomic<uint64_t> nextMetricsId(1);
+
+// shards of this thread, per collector id (ids are never reused). most recently used first
+
+struct ThreadShard
+{
+   uint64_t id;
+   void* shard;
+};
+
+static thread_local std::vector<ThreadShard> threadShards;
+
+//***************************************************************************
+// class Histogram
+//***************************************************************************
+// buckets
+//***************************************************************************
+
+size_t Histogram::bucketOf(uint64_t value)
+{
+   if (value < subBuckets)
+      return (size_t)value;
+
+   int msb= 63 - __builtin_clzll(value);
+
+   if (msb > maxExponent)
+      return bucketCount - 1;
+
+   // 16 buckets per power of two: the 4 bits following the most significant one
+
+   int shift= msb - 4;
+
+   return subBuckets + shift * subBuckets + (size_t)((value >> shift) - subBuckets);
+}
+
+uint64_t Histogram::lowerBound(size_t bucket)
+{
+   if (bucket < subBuckets)
+      return bucket;
+
+   size_t shift= (bucket - subBuckets) / subBuckets;
+
+   return (uint64_t)(subBuckets + (bucket - subBuckets) % subBuckets) << shift;
+}
+
+uint64_t Histogram::upperBound(size_t bucket)
+{
+   if (bucket < subBuckets)
+      return bucket;
+
+   if (bucket >= bucketCount - 1)
+      return UINT64_MAX;
+
+   return lowerBound(bucket) + ((uint64_t)1 << ((bucket - subBuckets) / subBuckets)) - 1;
+}
+
+//***************************************************************************
+// add
+//***************************************************************************
+
+void Histogram::add(size_t bucket, uint64_t count, uint64_t valueSum)
+{
+   if (bucket >= bucketCount)
+      bucket= bucketCount - 1;
+
+   counts[bucket]+= count;
+   total+= count;
+   sum+= valueSum;
+}
+
+//***************************************************************************
+// percentile
+//***************************************************************************
+
+uint64_t Histogram::percentile(double p) const
+{
+   if (!total)
+      return 0;
+
+   uint64_t rank= (uint64_t)(p * total + 0.5);
+   uint64_t seen= 0;
+
+   if (rank < 1)
+      rank= 1;
+
+   for (size_t i= 0; i < bucketCount; i++)
+   {
+      seen+= counts[i];
+
+      if (seen >= rank)
+         return upperBound(i);
+   }
+
+   return upperBound(bucketCount - 1);
+}
+
+//***************************************************************************
+// countUpTo
+//***************************************************************************
+
+uint64_t Histogram::countUpTo(uint64_t value) const
+{
+   uint64_t result= 0;
+
+   for (size_t i= 0; i < bucketCount && upperBound(i) <= value; i++)
+      result+= counts[i];
+
+   return result;
+}
+
+//***************************************************************************
+// class Metrics
+//***************************************************************************
+// shards
+//***************************************************************************
+
+Metrics::HistogramShard::HistogramShard()
+   : sum(0), skipped(0)
+{
+   for (size_t i= 0; i < Histogram::bucketCount; i++)
+      buckets[i].store(0, std::memory_order_relaxed);
+}
+
+Metrics::Shard::Shard(size_t routeCount, size_t wareCount)
+   : routes(new std::atomic<HistogramShard*>[routeCount]), wares(new std::atomic<HistogramShard*>[wareCount]),
+     routeCount(routeCount), wareCount(wareCount)
+{
+   for (size_t i= 0; i < mcCount; i++)
+      counters[i].store(0, std::memory_order_relaxed);
+
+   for (size_t i= 0; i < 600; i++)
+      statusCodes[i].store(0, std::memory_order_relaxed);
+
+   for (size_t i= 0; i < routeCount; i++)
+      routes[i].store(nullptr, std::memory_order_relaxed);
+
+   for (size_t i= 0; i < wareCount; i++)
+      wares[i].store(nullptr, std::memory_order_relaxed);
+}
+
+Metrics::Shard::~Shard()
+{
+   for (size_t i= 0; i < routeCount; i++)
+      delete routes[i].load();
+
+   for (size_t i= 0; i < wareCount; i++)
+      delete wares[i].load();
+}
+
+Metrics::HistogramShard* Metrics::histogramShard(std::atomic<HistogramShard*>& slot)
+{
+   // only the owning thread stores the pointer, snapshot() reads it
+
+   HistogramShard* result= slot.load(std::memory_order_relaxed);
+
+   if (!result)
+   {
+      result= new HistogramShard;
+      slot.store(result, std::memory_order_release);
+   }
+
+   return result;
+}
+
+//***************************************************************************
+// ctor/dtor
+//***************************************************************************
+
+Metrics::Metrics(const std::vector<std::string>& routes, const std::vector<std::string>& middlewares)
+   : routes(routes), wares(middlewares), id(nextMetricsId++)
+{
+   if (this->routes.empty())
+      this->routes.push_back("*");
+}
+
+Metrics::~Metrics()
+{
+}
+
+//***************************************************************************
+// shard (of the calling thread)
+//***************************************************************************
+
+Metrics::Shard* Metrics::shard()
+{
+   if (!threadShards.empty() && threadShards[0].id == id)
+      return (Shard*)threadShards[0].shard;
+
+   // a thread recording for several collectors (e.g. two servers) keeps its shard of each
+
+   for (size_t i= 1; i < threadShards.size(); i++)
+   {
+      if (threadShards[i].id == id)
+      {
+         std::rotate(threadShards.begin(), threadShards.begin() + i, threadShards.begin() + i + 1);
+         return (Shard*)threadShards[0].shard;
+      }
+   }
+
+   Shard* result= addShard();
+
+   if (threadShards.size() >= CEX_METRICS_THREAD_SHARDS)
+      threadShards.pop_back();
+
+   threadShards.insert(threadShards.begin(), ThreadShard{ id, result });
+
+   return result;
+}
+
+Metrics::Shard* Metrics::addShard()
+{
+   // only if the thread did not record for this collector yet (or too many others meanwhile)
+
+   std::lock_guard<std::mutex> lock(mutex);
+
+   shards.push_back(std::unique_ptr<Shard>(new Shard(routes.size(), wares.size())));
+
+   return shards.back().get();
+}
+
+//***************************************************************************
+// addLatency
+//***************************************************************************
+
+void Metrics::addLatency(size_t route, uint64_t micros)
+{
+   Shard* own= shard();
+
+   if (route >= routes.size())
+      route= 0;
+
+   HistogramShard* routeShard= histogramShard(own->routes[route]);
+
+   increment(routeShard->buckets[Histogram::bucketOf(micros)], 1);
+   increment(routeShard->sum, micros);
+}
+
+//***************************************************************************
+// addMiddlewareTime/addSkipped
+//***************************************************************************
+
+void Metrics::addMiddlewareTime(size_t ware, uint64_t nanos)
+{
+   if (ware >= wares.size())
+      return;
+
+   HistogramShard* wareShard= histogramShard(shard()->wares[ware]);
+
+   increment(wareShard->buckets[Histogram::bucketOf(nanos)], 1);
+   increment(wareShard->sum, nanos);
+}
+
+void Metrics::addSkipped(size_t ware, uint64_t count)
+{
+   if (ware < wares.size())
+      increment(histogramShard(shard()->wares[ware])->skipped, count);
+}
+
+//***************************************************************************
+// snapshot
+//***************************************************************************
+
+MetricsSnapshot Metrics::snapshot()
+{
+   MetricsSnapshot result;
+   uint64_t counters[mcCount]= { 0 };
+   std::vector<uint64_t> statusCodes(600, 0);
+   std::vector<MetricsSnapshot::Route> routeSums(routes.size());
+   std::vector<MetricsSnapshot::MiddlewareTiming> wareSums(wares.size());
+   std::vector<bool> routeUsed(routes.size(), false);
+   std::vector<bool> wareUsed(wares.size(), false);
+
+   std::lock_guard<std::mutex> lock(mutex);
+
+   for (size_t i= 0; i < shards.size(); i++)
+   {
+      Shard* s= shards[i].get();
+
+      for (size_t c= 0; c < mcCount; c++)
+         counters[c]+= s->counters[c].load(std::memory_order_relaxed);
+
+      for (size_t c= 0; c < statusCodes.size(); c++)
+         statusCodes[c]+= s->statusCodes[c].load(std::memory_order_relaxed);
+
+      for (size_t r= 0; r < routes.size(); r++)
+      {
+         HistogramShard* routeShard= s->routes[r].load(std::memory_order_acquire);
+
+         if (routeShard)
+         {
+            addHistogram(routeSums[r].latency, routeShard);
+            routeUsed[r]= true;
+         }
+      }
+
+      for (size_t w= 0; w < wares.size(); w++)
+      {
+         HistogramShard* wareShard= s->wares[w].load(std::memory_order_acquire);
+
+         if (wareShard)
+         {
+            addHistogram(wareSums[w].duration, wareShard);
+            wareSums[w].skipped+= wareShard->skipped.load(std::memory_order_relaxed);
+            wareUsed[w]= true;
+         }
+      }
+   }
+
+   result.requests= counters[mcRequests];
+   result.bytesIn= counters[mcBytesIn];
+   result.bytesOut= counters[mcBytesOut];
+   result.compressedIn= counters[mcCompressedIn];
+   result.compressedOut= counters[mcCompressedOut];
+   result.unmatched= counters[mcUnmatched];
+
+   // opened and closed are counted by the same threads, but read one after the other
+
+   result.connections= counters[mcConnectionsOpened] > counters[mcConnectionsClosed] ? counters[mcConnectionsOpened] - counters[mcConnectionsClosed] : 0;
+
+   for (size_t c= 0; c < statusCodes.size(); c++)
+   {
+      if (statusCodes[c])
+         result.statusCodes.push_back(std::make_pair((int)c, statusCodes[c]));
+   }
+
+   // only routes/middlewares which had requests
+
+   for (size_t r= 0; r < routes.size(); r++)
+   {
+      if (!routeUsed[r])
+         continue;
+
+      routeSums[r].path= routes[r];
+      result.routes.push_back(std::move(routeSums[r]));
+   }
+
+   for (size_t w= 0; w < wares.size(); w++)
+   {
+      if (!wareUsed[w])
+         continue;
+
+      wareSums[w].index= w;
+      wareSums[w].path= wares[w];
+      result.middlewares.push_back(std::move(wareSums[w]));
+   }
+
+   return result;
+}
+
+void Metrics::addHistogram(Histogram& histogram, HistogramShard* shard)
+{
+   for (size_t b= 0; b < Histogram::bucketCount; b++)
+   {
+      uint64_t n= shard->buckets[b].load(std::memory_order_relaxed);
+
+      if (n)
+         histogram.add(b, n, 0);
+   }
+
+   histogram.add(0, 0, shard->sum.load(std::memory_order_relaxed));
+}
+
+//***************************************************************************
+// class MetricsSnapshot
+//***************************************************************************
+// prometheus (text exposition format 0.0.4)
+//***************************************************************************
+
+static std::string escapeLabel(const std::string& value)
+{
+   std::string result;
+
+   for (size_t i= 0; i < value.size(); i++)
+   {
+      switch (value[i])
+      {
+         case '\\': result+= "\\\\"; break;
+         case '"':  result+= "\\\""; break;
+         case '\n': result+= "\\n"; break;
+         default:   result+= value[i]; break;
+      }
+   }
+
+   return result;
+}
+
+static void appendMetric(std::string& out, const char* name, const char* type, const char* help, uint64_t value)
+{
+   char line[256];
+
+   snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n%s %llu\n", name, help, name, type, name, (unsigned long long)value);
+   out+= line;
+}
+
+std::string MetricsSnapshot::prometheus() const
+{
+   // bucket bounds of the latency histograms, in microseconds
+
+   static const uint64_t bounds[]= { 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000 };
+
+   std::string out;
+   char line[512];
+
+   appendMetric(out, "cex_requests_total", "counter", "Finished requests.", requests);
+   appendMetric(out, "cex_request_body_bytes_total", "counter", "Received request body bytes.", bytesIn);
+   appendMetric(out, "cex_response_body_bytes_total", "counter", "Sent response body bytes.", bytesOut);
+   appendMetric(out, "cex_compression_input_bytes_total", "counter", "Response body bytes passed to compression.", compressedIn);
+   appendMetric(out, "cex_compression_output_bytes_total", "counter", "Compressed response body bytes.", compressedOut);
+   appendMetric(out, "cex_connections", "gauge", "Open connections.", connections);
+
+   out+= "# HELP cex_responses_total Responses by HTTP status code.\n# TYPE cex_responses_total counter\n";
+
+   for (size_t i= 0; i < statusCodes.size(); i++)
+   {
+      snprintf(line, sizeof(line), "cex_responses_total{code=\"%d\"} %llu\n", statusCodes[i].first, (unsigned long long)statusCodes[i].second);
+      out+= line;
+   }
+
+   out+= "# HELP cex_request_duration_seconds Time from receiving the request headers until the request is finished.\n"
+         "# TYPE cex_request_duration_seconds histogram\n";
+
+   for (size_t r= 0; r < routes.size(); r++)
+   {
+      // paths (e.g. regular expressions) may be long, so the label is not formatted with snprintf
+
+      std::string route= "{route=\"" + escapeLabel(routes[r].path) + "\"";
+      const Histogram& latency= routes[r].latency;
+
+      for (size_t b= 0; b < sizeof(bounds)/sizeof(bounds[0]); b++)
+      {
+         snprintf(line, sizeof(line), ",le=\"%g\"} %llu\n", bounds[b] / 1e6, (unsigned long long)latency.countUpTo(bounds[b]));
+         out+= "cex_request_duration_seconds_bucket" + route + line;
+      }
+
+      snprintf(line, sizeof(line), ",le=\"+Inf\"} %llu\n", (unsigned long long)latency.count());
+      out+= "cex_request_duration_seconds_bucket" + route + line;
+
+      snprintf(line, sizeof(line), "} %.6f\n", latency.getSum() / 1e6);
+      out+= "cex_request_duration_seconds_sum" + route + line;
+
+      snprintf(line, sizeof(line), "} %llu\n", (unsigned long long)latency.count());
+      out+= "cex_request_duration_seconds_count" + route + line;
+   }
+
+#ifdef CEX_WITH_CHAIN_TIMING
+   appendMetric(out, "cex_middleware_unmatched_total", "counter", "Non-matching candidates evaluated after the last called middleware.", unmatched);
+#endif
+
+   if (middlewares.empty())
+      return out;
+
+   // time per middleware function call, as summary with the quantiles of the histogram
+
+   static const double quantiles[]= { 0.5, 0.9, 0.99 };
+
+   out+= "# HELP cex_middleware_duration_seconds Time spent in a middleware function call.\n"
+         "# TYPE cex_middleware_duration_seconds summary\n";
+
+   for (size_t w= 0; w < middlewares.size(); w++)
+   {
+      snprintf(line, sizeof(line), "{middleware=\"%zu\",path=\"", middlewares[w].index);
+
+      std::string ware= line + escapeLabel(middlewares[w].path) + "\"";
+      const Histogram& duration= middlewares[w].duration;
+
+      for (size_t q= 0; q < sizeof(quantiles)/sizeof(quantiles[0]); q++)
+      {
+         snprintf(line, sizeof(line), ",quantile=\"%g\"} %.9f\n", quantiles[q], duration.percentile(quantiles[q]) / 1e9);
+         out+= "cex_middleware_duration_seconds" + ware + line;
+      }
+
+      snprintf(line, sizeof(line), "} %.9f\n", duration.getSum() / 1e9);
+      out+= "cex_middleware_duration_seconds_sum" + ware + line;
+
+      snprintf(line, sizeof(line), "} %llu\n", (unsigned long long)duration.count());
+      out+= "cex_middleware_duration_seconds_count" + ware + line;
+   }
+
+   out+= "# HELP cex_middleware_skipped_total Non-matching candidates evaluated before a middleware was called.\n"
+         "# TYPE cex_middleware_skipped_total counter\n";
+
+   for (size_t w= 0; w < middlewares.size(); w++)
+   {
+      snprintf(line, sizeof(line), "{middleware=\"%zu\",path=\"", middlewares[w].index);
+      out+= "cex_middleware_skipped_total" + (line + escapeLabel(middlewares[w].path));
+
+      snprintf(line, sizeof(line), "\"} %llu\n", (unsigned long long)middlewares[w].skipped);
+      out+= line;
+   }
+
+   return out;
+}
+
+//***************************************************************************
+// Middleware metricsHandler
+//***************************************************************************
+
+MiddlewareFunction metricsHandler(Server* server)
+{
+   MiddlewareFunction res = [server](Request* req, Response* res, std::function<void()> next)
+   {
+      std::string body= server->getMetrics().prometheus();
+
+      res->set("Content-Type", "text/plain; version=0.0.4");
+      res->end(body.c_str(), body.size(), 200);
+   };
+
+   return res;
+}
+
+//***************************************************************************
+} // namespace cex
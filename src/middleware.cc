@@ -25,30 +25,70 @@ namespace cex
 //***************************************************************************
 
 Middleware::Middleware(const char* aPath, MiddlewareFunction func, int aMethod, int aFlags)
-   : func(std::move(func)), rep(aPath ? aPath : ".*", std::regex::optimize),
-     method(aMethod), path(aPath ? aPath : ""), flags(aFlags)
+   : func(std::move(func)), method(aMethod), path(aPath ? aPath : ""), flags(aFlags)
 {
    if (!aPath)
       flags= flags & ~fMatching;
 
    type= tpStandard;
+   parsePath();
 }
 
 Middleware::Middleware(const char* aPath, UploadFunction func, int aMethod, int aFlags)
-   : uploadFunc(std::move(func)), rep(aPath ? aPath : ".*", std::regex::optimize),
-     method(aMethod), path(aPath ? aPath : ""), flags(aFlags)
+   : uploadFunc(std::move(func)), method(aMethod), path(aPath ? aPath : ""), flags(aFlags)
 {
    if (!aPath)
       flags= flags & ~fMatching;
 
    type= tpUpload;
+   parsePath();
+}
+
+//***************************************************************************
+// parse path (collect `:name` segments)
+//***************************************************************************
+
+void Middleware::parsePath()
+{
+   if (!(flags & fMatching))
+      return;
+
+   // regex paths are compiled once into an automaton. std::regex is only used for
+   // patterns the automaton does not support (e.g. backreferences, lookaheads)
+
+   if (flags & fMatchRegex)
+   {
+      if (!(flags & (fMatchCompare|fMatchContain)) && !regex.compile(path.c_str()))
+         rep.reset(new std::regex(path, std::regex::optimize));
+
+      return;
+   }
+
+   for (size_t i= 0; i < path.length(); i++)
+   {
+      if (path[i] != ':' || (i && path[i-1] != '/'))
+         continue;
+
+      size_t end= path.find('/', i);
+
+      if (end == std::string::npos)
+         end= path.length();
+
+      paramNames.push_back(path.substr(i+1, end-i-1));
+      i= end;
+   }
+
+   // parameterized paths always match the whole URL
+
+   if (paramNames.size())
+      flags= (flags & ~fMatching) | fMatchParams;
 }
 
 //***************************************************************************
 // match
 //***************************************************************************
 
-bool Middleware::match(Request* req)
+bool Middleware::match(Request* req, std::vector<StringView>* params)
 {
    if (method != na && method != req->evhtp_method)
       return false;
@@ -59,6 +99,11 @@ bool Middleware::match(Request* req)
    if (!req || !req->getUrl())
       return false;
 
+   // segment-wise compare, collecting the `:name` values
+
+   if (flags & fMatchParams)
+      return matchParams(req->getUrl(), params);
+
    // plain strcmp, faster than regex
 
    if (flags & fMatchCompare)
@@ -71,12 +116,62 @@ bool Middleware::match(Request* req)
 
    // full regular expression matching
 
+   if (!rep)
+      return regex.search(req->getUrl());
+
    std::cmatch m;
-   std::regex_search(req->getUrl(), m, rep);
+   std::regex_search(req->getUrl(), m, *rep);
 
    return m.size() > 0;
 }
 
+//***************************************************************************
+// match params
+//***************************************************************************
+
+bool Middleware::matchParams(const char* url, std::vector<StringView>* params)
+{
+   const char* p= path.c_str();
+   size_t oldSize= params ? params->size() : 0;
+
+   while (*p && *url)
+   {
+      if (*p == ':' && (p == path.c_str() || p[-1] == '/'))
+      {
+         const char* end= url;
+
+         while (*end && *end != '/')
+            end++;
+
+         if (end == url)
+            break;
+
+         if (params)
+            params->push_back(StringView(url, end-url));
+
+         while (*p && *p != '/')
+            p++;
+
+         url= end;
+         continue;
+      }
+
+      if (*p != *url)
+         break;
+
+      p++;
+      url++;
+   }
+
+   if (!*p && !*url)
+      return true;
+
+   if (params)
+      params->resize(oldSize);
+
+   return false;
+}
+
 //***************************************************************************
 } // namespace cex
 
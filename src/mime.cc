@@ -180,7 +180,7 @@ int Server::initMimeTypes()
    registerMimeType("xml", "text/xml", false);
    registerMimeType("xpm", "image/x-xpixmap", true);
    registerMimeType("xwd", "image/x-windowdump", true);
-   registerMimeType("z", "application/x-compress", false);
+   registerMimeType("z", "application/x-compress", true);
    registerMimeType("zip", "application/zip", true);
 
    return done;
@@ -193,6 +193,30 @@ int Server::initMimeTypes()
 void Server::registerMimeType(const char* extension, const char* mime, bool binary)
 {
    (*mimeTypes.get())[std::string(extension)]= std::make_pair(mime, binary);
+   (*binaryMimeTypes.get())[std::string(mime)]= binary;
+}
+
+//***************************************************************************
+// isCompressible
+//***************************************************************************
+
+bool Server::isCompressible(const char* contentType)
+{
+   if (!contentType)
+      return false;
+
+   const char* end= strchr(contentType, ';');
+   std::string type(contentType, end ? end - contentType : strlen(contentType));
+
+   while (!type.empty() && type.back() == ' ')
+      type.pop_back();
+
+   std::unordered_map<std::string,bool>::iterator it= binaryMimeTypes.get()->find(type);
+
+   if (it != binaryMimeTypes.get()->end())
+      return !it->second;
+
+   return !strncmp(type.c_str(), "text/", 5);
 }
 
 //***************************************************************************
@@ -0,0 +1,890 @@
+//*************************************************************************
+// File regex.cc
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// Class Regex
+// Thompson NFA + DFA regular expression matcher (no backtracking)
+//*************************************************************************
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+
+#include <cex/regex.hpp>
+
+#define REGEX_MAX_NODES   20000     // NFA size limit (counted repetitions are expanded)
+#define REGEX_MAX_STATES  2000      // DFA size limit, NFA is simulated above
+#define REGEX_MAX_DEPTH   200       // group nesting limit of the parser
+
+namespace cex
+{
+
+//***************************************************************************
+// struct Regex::Ast (parse tree)
+//***************************************************************************
+
+struct Regex::Ast
+{
+   enum Type
+   {
+      aChars,
+      aBegin,
+      aEnd,
+      aConcat,
+      aAlt,
+      aRepeat
+   };
+
+   explicit Ast(int type) : type(type), min(0), max(0) {}
+
+   int type;
+   CharSet set;
+   std::vector<std::shared_ptr<Ast>> sub;
+   int min;
+   int max;       // -1: unbounded
+};
+
+//***************************************************************************
+// struct Parser
+//***************************************************************************
+
+struct Parser
+{
+   typedef std::shared_ptr<Regex::Ast> AstPtr;
+
+   explicit Parser(const char* pattern) : p(pattern), ok(true), depth(0) {}
+
+   AstPtr parseAlt();
+   AstPtr parseConcat();
+   AstPtr parseRepeat();
+   AstPtr parseAtom();
+   bool parseEscape(Regex::CharSet& set, bool inClass);
+   bool parseClass(Regex::CharSet& set);
+   int parseNumber();
+
+   AstPtr fail() { ok= false; return AstPtr(); }
+
+   static void addRange(Regex::CharSet& set, int from, int to);
+   static int single(const Regex::CharSet& set);
+
+   const char* p;
+   bool ok;
+   int depth;
+};
+
+//***************************************************************************
+// character set helpers
+//***************************************************************************
+
+void Parser::addRange(Regex::CharSet& set, int from, int to)
+{
+   for (int c= from; c <= to; c++)
+      set.add((unsigned char)c);
+}
+
+int Parser::single(const Regex::CharSet& set)
+{
+   // returns the character if the set contains exactly one, otherwise -1
+
+   int res= -1;
+
+   for (int c= 0; c < 256; c++)
+   {
+      if (!set.has(c))
+         continue;
+
+      if (res != -1)
+         return -1;
+
+      res= c;
+   }
+
+   return res;
+}
+
+//***************************************************************************
+// parse alternation
+//***************************************************************************
+
+Parser::AstPtr Parser::parseAlt()
+{
+   if (++depth > REGEX_MAX_DEPTH)
+      return fail();
+
+   AstPtr alt(new Regex::Ast(Regex::Ast::aAlt));
+
+   alt->sub.push_back(parseConcat());
+
+   while (ok && *p == '|')
+   {
+      p++;
+      alt->sub.push_back(parseConcat());
+   }
+
+   depth--;
+
+   if (!ok)
+      return AstPtr();
+
+   return alt->sub.size() == 1 ? alt->sub[0] : alt;
+}
+
+//***************************************************************************
+// parse concatenation
+//***************************************************************************
+
+Parser::AstPtr Parser::parseConcat()
+{
+   AstPtr concat(new Regex::Ast(Regex::Ast::aConcat));
+
+   while (ok && *p && *p != '|' && *p != ')')
+   {
+      AstPtr item= parseRepeat();
+
+      if (item)
+         concat->sub.push_back(item);
+   }
+
+   return concat;
+}
+
+//***************************************************************************
+// parse repetition (quantifiers)
+//***************************************************************************
+
+Parser::AstPtr Parser::parseRepeat()
+{
+   AstPtr atom= parseAtom();
+
+   while (ok && atom && (*p == '*' || *p == '+' || *p == '?' || *p == '{'))
+   {
+      AstPtr repeat(new Regex::Ast(Regex::Ast::aRepeat));
+
+      repeat->sub.push_back(atom);
+
+      switch (*p++)
+      {
+         case '*': repeat->min= 0; repeat->max= -1; break;
+         case '+': repeat->min= 1; repeat->max= -1; break;
+         case '?': repeat->min= 0; repeat->max= 1;  break;
+         default:
+         {
+            repeat->min= repeat->max= parseNumber();
+
+            if (*p == ',')
+            {
+               p++;
+               repeat->max= *p == '}' ? -1 : parseNumber();
+            }
+
+            if (*p != '}' || repeat->min < 0 || (repeat->max != -1 && repeat->max < repeat->min))
+               return fail();
+
+            p++;
+            break;
+         }
+      }
+
+      // lazy quantifier: same result for a match/no-match decision
+
+      if (*p == '?')
+         p++;
+
+      atom= repeat;
+   }
+
+   return atom;
+}
+
+//***************************************************************************
+// parse number (counted repetition)
+//***************************************************************************
+
+int Parser::parseNumber()
+{
+   int res= 0;
+
+   if (*p < '0' || *p > '9')
+      return -1;
+
+   while (*p >= '0' && *p <= '9')
+   {
+      res= res*10 + (*p++ - '0');
+
+      if (res > 1000)
+         return -1;
+   }
+
+   return res;
+}
+
+//***************************************************************************
+// parse atom
+//***************************************************************************
+
+Parser::AstPtr Parser::parseAtom()
+{
+   AstPtr atom(new Regex::Ast(Regex::Ast::aChars));
+
+   switch (*p)
+   {
+      case '(':
+      {
+         p++;
+
+         // (?: ... ) is fine, lookaheads are not supported
+
+         if (*p == '?')
+         {
+            if (p[1] != ':')
+               return fail();
+
+            p += 2;
+         }
+
+         atom= parseAlt();
+
+         if (!ok || *p != ')')
+            return fail();
+
+         p++;
+         return atom;
+      }
+
+      case '[':
+         p++;
+         return parseClass(atom->set) ? atom : fail();
+
+      case '.':
+         p++;
+         atom->set.add('\n');
+         atom->set.add('\r');
+         atom->set.invert();
+         return atom;
+
+      case '^':
+         p++;
+         return AstPtr(new Regex::Ast(Regex::Ast::aBegin));
+
+      case '$':
+         p++;
+         return AstPtr(new Regex::Ast(Regex::Ast::aEnd));
+
+      case '\\':
+         p++;
+         return parseEscape(atom->set, false) ? atom : fail();
+
+      case '*': case '+': case '?': case '{': case ')':
+         return fail();
+
+      default:
+         atom->set.add((unsigned char)*p++);
+         return atom;
+   }
+}
+
+//***************************************************************************
+// parse escape sequence (p points behind the backslash)
+//***************************************************************************
+
+bool Parser::parseEscape(Regex::CharSet& set, bool inClass)
+{
+   Regex::CharSet tmp;
+
+   if (!*p)
+      return false;
+
+   char c= *p++;
+
+   switch (c)
+   {
+      case 'd': case 'D':
+         addRange(tmp, '0', '9');
+         break;
+
+      case 'w': case 'W':
+         addRange(tmp, '0', '9');
+         addRange(tmp, 'a', 'z');
+         addRange(tmp, 'A', 'Z');
+         tmp.add('_');
+         break;
+
+      case 's': case 'S':
+         tmp.add(' '); tmp.add('\t'); tmp.add('\n'); tmp.add('\r'); tmp.add('\f'); tmp.add('\v');
+         break;
+
+      case 'n': set.add('\n'); return true;
+      case 'r': set.add('\r'); return true;
+      case 't': set.add('\t'); return true;
+      case 'f': set.add('\f'); return true;
+      case 'v': set.add('\v'); return true;
+      case '0': set.add('\0'); return true;
+
+      case 'b':
+         if (!inClass)
+            return false;      // word boundary not supported
+
+         set.add('\b');
+         return true;
+
+      case 'x':
+      {
+         int value= 0;
+
+         for (int i= 0; i < 2; i++, p++)
+         {
+            if (*p >= '0' && *p <= '9')      value= value*16 + (*p - '0');
+            else if (*p >= 'a' && *p <= 'f') value= value*16 + (*p - 'a' + 10);
+            else if (*p >= 'A' && *p <= 'F') value= value*16 + (*p - 'A' + 10);
+            else return false;
+         }
+
+         set.add((unsigned char)value);
+         return true;
+      }
+
+      case 'B': case 'c': case 'u': case 'k':
+         return false;
+
+      default:
+         if (c >= '1' && c <= '9')
+            return false;      // backreference not supported
+
+         set.add((unsigned char)c);
+         return true;
+   }
+
+   if (c == 'D' || c == 'W' || c == 'S')
+      tmp.invert();
+
+   set.add(tmp);
+   return true;
+}
+
+//***************************************************************************
+// parse character class (p points behind the '[')
+//***************************************************************************
+
+bool Parser::parseClass(Regex::CharSet& set)
+{
+   bool negate= false;
+
+   if (*p == '^')
+   {
+      negate= true;
+      p++;
+   }
+
+   while (*p && *p != ']')
+   {
+      Regex::CharSet chars;
+      int from= -1;
+
+      if (*p == '[' && (p[1] == ':' || p[1] == '=' || p[1] == '.'))
+         return false;      // POSIX classes not supported
+
+      if (*p == '\\')
+      {
+         p++;
+
+         if (!parseEscape(chars, true))
+            return false;
+
+         // single character escapes (not \d etc.) can start a range
+
+         from= single(chars);
+      }
+      else
+      {
+         from= (unsigned char)*p++;
+         chars.add(from);
+      }
+
+      if (from >= 0 && *p == '-' && p[1] && p[1] != ']')
+      {
+         int to;
+
+         p++;
+
+         if (*p == '\\')
+         {
+            Regex::CharSet end;
+            p++;
+
+            if (!parseEscape(end, true))
+               return false;
+
+            to= single(end);
+         }
+         else
+            to= (unsigned char)*p++;
+
+         if (to < from)
+            return false;
+
+         addRange(chars, from, to);
+      }
+
+      set.add(chars);
+   }
+
+   if (*p != ']')
+      return false;
+
+   p++;
+
+   if (negate)
+      set.invert();
+
+   return true;
+}
+
+//***************************************************************************
+// class Regex
+//***************************************************************************
+// compile
+//***************************************************************************
+
+bool Regex::compile(const char* pattern)
+{
+   std::vector<std::string> patterns;
+
+   patterns.push_back(pattern ? pattern : "");
+
+   return compile(patterns);
+}
+
+bool Regex::compile(const std::vector<std::string>& patterns)
+{
+   nodes.clear();
+   starts.clear();
+   states.clear();
+   table.clear();
+   valid= false;
+   patternCount= 0;
+
+   for (size_t i= 0; i < patterns.size(); i++)
+   {
+      Parser parser(patterns[i].c_str());
+      std::shared_ptr<Ast> ast= parser.parseAlt();
+
+      if (!parser.ok || !ast || *parser.p)
+         return false;
+
+      nodes.push_back(Node(ndMatch));
+      nodes.back().id= i;
+
+      int start= build(ast.get(), nodes.size()-1);
+
+      if (start == na())
+         return false;
+
+      starts.push_back(start);
+   }
+
+   patternCount= patterns.size();
+   valid= true;
+
+   buildDfa();
+
+   return true;
+}
+
+//***************************************************************************
+// build (Thompson construction, back to front)
+//***************************************************************************
+
+int Regex::build(const Ast* ast, int next)
+{
+   if (next == na() || nodes.size() > REGEX_MAX_NODES)
+      return na();
+
+   switch (ast->type)
+   {
+      case Ast::aChars:
+         nodes.push_back(Node(ndChar, next));
+         nodes.back().set= ast->set;
+         return nodes.size()-1;
+
+      case Ast::aBegin:
+         nodes.push_back(Node(ndBegin, next));
+         return nodes.size()-1;
+
+      case Ast::aEnd:
+         nodes.push_back(Node(ndEnd, next));
+         return nodes.size()-1;
+
+      case Ast::aConcat:
+      {
+         for (size_t i= ast->sub.size(); i > 0; i--)
+            next= build(ast->sub[i-1].get(), next);
+
+         return next;
+      }
+
+      case Ast::aAlt:
+      {
+         int res= build(ast->sub.back().get(), next);
+
+         for (size_t i= ast->sub.size()-1; i > 0 && res != na(); i--)
+         {
+            int alternative= build(ast->sub[i-1].get(), next);
+
+            nodes.push_back(Node(ndSplit, alternative, res));
+            res= alternative != na() ? (int)nodes.size()-1 : na();
+         }
+
+         return res;
+      }
+
+      case Ast::aRepeat:
+      {
+         const Ast* body= ast->sub[0].get();
+         int rest= next;
+
+         if (ast->max == -1)
+         {
+            // loop: split -> body -> split, or leave
+
+            nodes.push_back(Node(ndSplit, na(), next));
+            int split= nodes.size()-1;
+            int start= build(body, split);
+
+            nodes[split].out= start;
+            rest= start != na() ? split : na();
+         }
+         else
+         {
+            for (int i= ast->min; i < ast->max && rest != na(); i++)
+            {
+               int start= build(body, rest);
+
+               nodes.push_back(Node(ndSplit, start, next));
+               rest= start != na() ? (int)nodes.size()-1 : na();
+            }
+         }
+
+         for (int i= 0; i < ast->min && rest != na(); i++)
+            rest= build(body, rest);
+
+         return rest;
+      }
+   }
+
+   return na();
+}
+
+//***************************************************************************
+// closure (epsilon closure of NFA nodes)
+//***************************************************************************
+
+void Regex::closure(std::vector<int>& set, int node, bool atStart, bool atEnd, std::vector<char>& seen) const
+{
+   std::vector<int> stack(1, node);
+
+   while (!stack.empty())
+   {
+      int n= stack.back();
+      stack.pop_back();
+
+      if (n == na() || seen[n])
+         continue;
+
+      seen[n]= 1;
+
+      switch (nodes[n].type)
+      {
+         case ndSplit:
+            stack.push_back(nodes[n].out1);
+            stack.push_back(nodes[n].out);
+            break;
+
+         case ndBegin:
+            if (atStart)
+               stack.push_back(nodes[n].out);
+            break;
+
+         case ndEnd:
+            if (atEnd)
+               stack.push_back(nodes[n].out);
+            else
+               set.push_back(n);
+            break;
+
+         default:
+            set.push_back(n);
+            break;
+      }
+   }
+}
+
+void Regex::closure(std::vector<int>& set, const std::vector<int>& from, bool atStart, bool atEnd) const
+{
+   std::vector<char> seen(nodes.size(), 0);
+
+   set.clear();
+
+   for (size_t i= 0; i < from.size(); i++)
+      closure(set, from[i], atStart, atEnd, seen);
+
+   std::sort(set.begin(), set.end());
+}
+
+//***************************************************************************
+// step (consume one character, then restart all patterns for the next position)
+//***************************************************************************
+
+void Regex::step(const std::vector<int>& from, unsigned char c, std::vector<int>& to) const
+{
+   std::vector<int> next;
+
+   for (size_t i= 0; i < from.size(); i++)
+   {
+      const Node& n= nodes[from[i]];
+
+      if (n.type == ndChar && n.set.has(c))
+         next.push_back(n.out);
+   }
+
+   next.insert(next.end(), starts.begin(), starts.end());
+   closure(to, next, false, false);
+}
+
+//***************************************************************************
+// collect (match ids of a NFA node set)
+//***************************************************************************
+
+void Regex::collect(const std::vector<int>& set, bool atStart, std::vector<int>& matches, std::vector<int>& endMatches) const
+{
+   std::vector<int> ends, endSet;
+
+   matches.clear();
+   endMatches.clear();
+
+   for (size_t i= 0; i < set.size(); i++)
+   {
+      if (nodes[set[i]].type == ndMatch)
+         matches.push_back(nodes[set[i]].id);
+      else if (nodes[set[i]].type == ndEnd)
+         ends.push_back(set[i]);
+   }
+
+   if (ends.empty())
+      return;
+
+   closure(endSet, ends, atStart, true);
+
+   for (size_t i= 0; i < endSet.size(); i++)
+   {
+      if (nodes[endSet[i]].type == ndMatch)
+         endMatches.push_back(nodes[endSet[i]].id);
+   }
+}
+
+//***************************************************************************
+// build DFA (subset construction over byte equivalence classes)
+//***************************************************************************
+
+void Regex::buildDfa()
+{
+   // (1) bytes which are not distinguished by any character set share a class
+
+   int refine[512];
+
+   memset(classes, 0, sizeof(classes));
+   classCount= 1;
+
+   for (size_t n= 0; n < nodes.size(); n++)
+   {
+      if (nodes[n].type != ndChar)
+         continue;
+
+      int count= 0;
+
+      for (int i= 0; i < classCount*2; i++)
+         refine[i]= na();
+
+      for (int c= 0; c < 256; c++)
+      {
+         int key= classes[c]*2 + (nodes[n].set.has(c) ? 1 : 0);
+
+         if (refine[key] == na())
+            refine[key]= count++;
+
+         classes[c]= refine[key];
+      }
+
+      classCount= count;
+   }
+
+   std::vector<unsigned char> representative(classCount);
+
+   for (int c= 255; c >= 0; c--)
+      representative[classes[c]]= c;
+
+   // (2) subset construction
+
+   std::map<std::vector<int>, int> index;
+   std::vector<int> set;
+
+   // the initial state is not put into the index: the same NFA nodes can have different
+   // end-matches there (anchors), so later positions always get their own state
+
+   states.resize(1);
+   closure(states[0].nodes, starts, true, false);
+   collect(states[0].nodes, true, states[0].matches, states[0].endMatches);
+
+   for (size_t s= 0; s < states.size(); s++)
+   {
+      for (int k= 0; k < classCount; k++)
+      {
+         step(states[s].nodes, representative[k], set);
+
+         std::map<std::vector<int>, int>::iterator it= index.find(set);
+         int target;
+
+         if (it != index.end())
+         {
+            target= it->second;
+         }
+         else
+         {
+            if (states.size() >= REGEX_MAX_STATES)
+            {
+               // too big. simulate the NFA instead
+
+               states.clear();
+               table.clear();
+               return;
+            }
+
+            target= states.size();
+            states.push_back(State());
+            states.back().nodes= set;
+            collect(set, false, states.back().matches, states.back().endMatches);
+            index[set]= target;
+         }
+
+         table.push_back(target);
+      }
+   }
+}
+
+//***************************************************************************
+// search
+//***************************************************************************
+
+bool Regex::search(const char* str) const
+{
+   bool any= false;
+
+   if (!valid || !str)
+      return false;
+
+   if (states.empty())
+   {
+      simulate(str, 0, any);
+      return any;
+   }
+
+   const unsigned char* p= (const unsigned char*)str;
+   int s= 0;
+
+   for (; *p; p++)
+   {
+      if (!states[s].matches.empty())
+         return true;
+
+      s= table[s*classCount + classes[*p]];
+
+      if (states[s].nodes.empty())
+         return false;
+   }
+
+   return !states[s].matches.empty() || !states[s].endMatches.empty();
+}
+
+void Regex::search(const char* str, std::vector<int>& ids) const
+{
+   size_t oldSize= ids.size();
+   bool any= false;
+
+   if (!valid || !str)
+      return;
+
+   if (states.empty())
+   {
+      simulate(str, &ids, any);
+   }
+   else
+   {
+      const unsigned char* p= (const unsigned char*)str;
+      int s= 0, last= na();
+
+      for (; *p; p++)
+      {
+         if (s != last && !states[s].matches.empty())
+            ids.insert(ids.end(), states[s].matches.begin(), states[s].matches.end());
+
+         last= s;
+         s= table[s*classCount + classes[*p]];
+
+         if (states[s].nodes.empty())
+            break;
+      }
+
+      if (s != last)
+         ids.insert(ids.end(), states[s].matches.begin(), states[s].matches.end());
+
+      if (!*p)
+         ids.insert(ids.end(), states[s].endMatches.begin(), states[s].endMatches.end());
+   }
+
+   std::sort(ids.begin() + oldSize, ids.end());
+   ids.erase(std::unique(ids.begin() + oldSize, ids.end()), ids.end());
+}
+
+//***************************************************************************
+// simulate (NFA set simulation, used if the DFA would be too big)
+//***************************************************************************
+
+void Regex::simulate(const char* str, std::vector<int>* ids, bool& any) const
+{
+   const unsigned char* p= (const unsigned char*)str;
+   std::vector<int> set, next, matches, endMatches;
+
+   closure(set, starts, true, false);
+
+   for (bool atStart= true; ; atStart= false)
+   {
+      collect(set, atStart, matches, endMatches);
+
+      if (!*p)
+         matches.insert(matches.end(), endMatches.begin(), endMatches.end());
+
+      if (!matches.empty())
+      {
+         any= true;
+
+         if (!ids)
+            return;
+
+         ids->insert(ids->end(), matches.begin(), matches.end());
+      }
+
+      if (!*p || set.empty())
+         return;
+
+      step(set, *p++, next);
+      set.swap(next);
+   }
+}
+
+//***************************************************************************
+} // namespace cex
@@ -10,6 +10,7 @@
 // includes
 //***************************************************************************
 
+#include <algorithm>
 #include <iostream>
 
 #include <cex/core.hpp>
@@ -25,11 +26,46 @@ namespace cex
 //***************************************************************************
 
 Request::Request(evhtp_request* req) 
-   : req(req)
+   : req(req), bodyBuffer(0), paramNames(0), paramValues(0), paramOffset(0)
 {
    parse();
 }
 
+Request::~Request()
+{
+   if (bodyBuffer)
+      evbuffer_free(bodyBuffer);
+}
+
+//***************************************************************************
+// reset (recycled request, see Server::Context)
+//***************************************************************************
+
+void Request::reset(evhtp_request* aReq)
+{
+   // clear() keeps the capacity of the buffers, except for huge bodies
+
+   req= aReq;
+   paramNames= 0;
+   paramValues= 0;
+   paramOffset= 0;
+
+   host.clear();
+   middlewarePath.clear();
+   properties.clear();
+   requestArena.reset();
+
+   if (body.capacity() > CEX_CONTEXT_POOL_MAX_BODY)
+      std::vector<char>().swap(body);
+   else
+      body.clear();
+
+   if (bodyBuffer)
+      evbuffer_drain(bodyBuffer, evbuffer_get_length(bodyBuffer));
+
+   parse();
+}
+
 //***************************************************************************
 // get (header value)
 //***************************************************************************
@@ -100,12 +136,50 @@ int Request::keyValueIteratorCb(evhtp_kv_t * kv, void * arg)
 
 const char* Request::getBody()
 {
+   size_t pending= bodyBuffer ? evbuffer_get_length(bodyBuffer) : 0;
+
+   if (pending)
+   {
+      // join the received chunks (once). sized by what was actually received, the
+      // announced Content-Length is up to the client
+
+      size_t oldSize= body.size();
+
+      body.resize(oldSize + pending);
+
+      evbuffer_remove(bodyBuffer, body.data() + oldSize, pending);
+   }
+
    return body.data();
 }
 
 size_t Request::getBodyLength()
 {
-   return body.size();
+   return body.size() + (bodyBuffer ? evbuffer_get_length(bodyBuffer) : 0);
+}
+
+const std::vector<StringView>& Request::bodyChunks()
+{
+   chunks.clear();
+
+   if (body.size())
+      chunks.push_back(StringView(body.data(), body.size()));
+
+   int count= bodyBuffer ? evbuffer_peek(bodyBuffer, -1, NULL, NULL, 0) : 0;
+
+   if (count > 0)
+   {
+      // evbuffer_iovec array lives in the request's arena
+
+      struct evbuffer_iovec* vecs= (struct evbuffer_iovec*)requestArena.alloc(count * sizeof(struct evbuffer_iovec));
+
+      count= evbuffer_peek(bodyBuffer, -1, NULL, vecs, count);
+
+      for (int i= 0; i < count; i++)
+         chunks.push_back(StringView((const char*)vecs[i].iov_base, vecs[i].iov_len));
+   }
+
+   return chunks;
 }
 
 int Request::getPort()
@@ -148,6 +222,20 @@ const char* Request::getMiddlewarePath()
    return middlewarePath.c_str();
 }
 
+StringView Request::getParam(const char* name)
+{
+   if (!name || !paramNames || !paramValues)
+      return StringView();
+
+   for (size_t i= 0; i < paramNames->size(); i++)
+   {
+      if ((*paramNames)[i] == name)
+         return paramOffset + i < paramValues->size() ? (*paramValues)[paramOffset + i] : StringView();
+   }
+
+   return StringView();
+}
+
 //***************************************************************************
 // parse
 //***************************************************************************
@@ -11,6 +11,8 @@
 //***************************************************************************
 
 #include <iostream>
+#include <sstream>
+#include <unistd.h>
 
 #include <cex/core.hpp>
 #include <cex/ssl.hpp>
@@ -18,21 +20,65 @@
 
 namespace cex
 {
+//***************************************************************************
+// class Response::Streaming (state of a response sent by sendChunk)
+//***************************************************************************
+
+struct Response::Streaming
+{
+   Streaming() : chunk(evbuffer_new()) {}
+   ~Streaming() { if (chunk) evbuffer_free(chunk); }
+
+   std::unique_ptr<std::istream> stream;
+#ifdef CEX_WITH_COMPRESSION
+   std::unique_ptr<Compressor> compressor;
+#endif
+   struct evbuffer* chunk;
+};
+
 //***************************************************************************
 // class Response
 //***************************************************************************
-// set (HTTP header)
+// statics
+//***************************************************************************
+
+thread_local Response* Response::offloading= nullptr;
+
+//***************************************************************************
+// ctor/dtor
 //***************************************************************************
 
 Response::Response(evhtp_request* req)
-   : req(req), state(stInit) 
+   : req(req), state(stInit), offloaded(false), bytesOut(0), compressedIn(0), compressedOut(0)
 {
    flags= 0;
 }
 
+Response::~Response()
+{
+}
+
+//***************************************************************************
+// reset (recycled response, see Server::Context)
+//***************************************************************************
+
+void Response::reset(evhtp_request* aReq)
+{
+   req= aReq;
+   state= stInit;
+   flags= 0;
+   offloadOps.clear();
+   offloaded= false;
+   bytesOut= compressedIn= compressedOut= 0;
+}
+
+//***************************************************************************
+// set (HTTP header)
+//***************************************************************************
+
 void Response::set(const char* headerName, const char* headerValue)
 {
-   if (!req || !req->headers_out)
+   if (!req || !req->headers_out || ownedByPool())
       return;
 
    evhtp_header_key_add(req->headers_out, headerName, 1);
@@ -41,7 +87,7 @@ void Response::set(const char* headerName, const char* headerValue)
 
 void Response::set(const char* headerName, int headerValue)
 {
-   if (!req || !req->headers_out)
+   if (!req || !req->headers_out || ownedByPool())
       return;
    
    char number[100];
@@ -51,6 +97,43 @@ void Response::set(const char* headerName, int headerValue)
    evhtp_header_val_add(req->headers_out, number, 1);
 }
 
+//***************************************************************************
+// compressible
+//***************************************************************************
+
+bool Response::compressible(size_t length, const char* contentType)
+{
+   if (!(flags & fCompression) || length < compression.minBytes)
+      return false;
+
+   // flags may have been set manually for an encoding the library was built without
+
+   switch (compressionMode(flags))
+   {
+#ifdef CEX_WITH_ZLIB
+      case cmDeflate:
+      case cmGZip:
+#endif
+#ifdef CEX_WITH_BROTLI
+      case cmBrotli:
+#endif
+#ifdef CEX_WITH_ZSTD
+      case cmZstd:
+#endif
+         break;
+
+      default:
+         return false;
+   }
+
+   if (!contentType && req && req->headers_out)
+      contentType= evhtp_header_find(req->headers_out, "Content-Type");
+
+   // no Content-Type: most likely a plain text/JSON reply
+
+   return !contentType || Server::isCompressible(contentType);
+}
+
 //***************************************************************************
 // end (sent response payload)
 //***************************************************************************
@@ -65,19 +148,30 @@ int Response::end(const char* buf, size_t bufLen, int status)
    if (state == stDone)
       return done;
 
-   if (!buf || bufLen <= 0)
+   if (!buf || bufLen <= 0 || ownedByPool())
       return fail;
 
+   if (offloading == this)
+   {
+      std::string copy(buf, bufLen);
+      return postOffloaded([this, copy, status]() { end(copy.data(), copy.size(), status); });
+   }
+
    auto* buffer= req->buffer_out;
 
    if (!buffer)
       return fail;
 
-#ifdef CEX_WITH_ZLIB
-   if (flags & fCompression)
+#ifdef CEX_WITH_COMPRESSION
+   if (compressible(bufLen))
    {
-      compress((char*)buf, bufLen, buffer, flags & fCompressGZip ? cmGZip : cmDeflate);
-      set("Content-Encoding", flags & fCompressGZip ? "gzip" : "deflate");
+      CompressionMode mode= compressionMode(flags);
+
+      compress((char*)buf, bufLen, buffer, mode, &compression);
+      set("Content-Encoding", compressionEncoding(mode));
+
+      compressedIn+= bufLen;
+      compressedOut+= evbuffer_get_length(buffer);
    }
    else
 #endif
@@ -85,6 +179,8 @@ int Response::end(const char* buf, size_t bufLen, int status)
       evbuffer_add(buffer, buf, bufLen);
    }
 
+   bytesOut+= evbuffer_get_length(buffer);
+
    evhtp_send_reply_start(req, status);
    evhtp_send_reply_body(req, buffer);
    evhtp_send_reply_end(req);
@@ -98,11 +194,100 @@ int Response::end(int status)
    if (state == stDone)
       return done;
 
+   if (ownedByPool())
+      return fail;
+
+   if (offloading == this)
+      return postOffloaded([this, status]() { end(status); });
+
    evhtp_send_reply(req, status);
    state= stDone;
    return done;
 }
 
+int Response::end(struct evbuffer* body, int status)
+{
+   if (!body || ownedByPool())
+      return fail;
+
+   // the contents are moved right away, the caller may free the buffer after returning
+
+   if (offloading == this)
+   {
+      std::shared_ptr<struct evbuffer> moved(evbuffer_new(), &evbuffer_free);
+
+      if (!moved || evbuffer_add_buffer(moved.get(), body))
+         return fail;
+
+      return postOffloaded([this, moved, status]() { end(moved.get(), status); });
+   }
+
+   return end(status, evbuffer_get_length(body), [body](struct evbuffer* output)
+   {
+      return evbuffer_add_buffer(output, body) ? (int)fail : (int)done;
+   });
+}
+
+int Response::end(int status, size_t contentLength, const std::function<int(struct evbuffer* output)>& writeBody)
+{
+   if (state == stDone)
+      return done;
+
+   if (ownedByPool())
+      return fail;
+
+   if (offloading == this)
+   {
+      // the callback may refer to the caller's stack (e.g. the file segment of sendRanges), so it runs
+      // right away. its output (including file segments) is moved into the connection later on.
+
+      std::shared_ptr<struct evbuffer> body(evbuffer_new(), &evbuffer_free);
+
+      if (!body)
+         return fail;
+
+      int res= writeBody ? writeBody(body.get()) : done;
+
+      postOffloaded([this, status, contentLength, body, res]()
+      {
+         end(status, contentLength, [body, res](struct evbuffer* output)
+         {
+            return evbuffer_add_buffer(output, body.get()) || res != done ? (int)fail : (int)done;
+         });
+      });
+
+      return res;
+   }
+
+   evhtp_connection_t* conn= evhtp_request_get_connection(req);
+   struct bufferevent* bev= conn ? evhtp_connection_get_bev(conn) : nullptr;
+
+   if (!bev)
+      return fail;
+
+   char number[30];
+   sprintf(number, "%zu", contentLength);
+
+   set("Content-Length", number);
+
+   // the body bypasses req->buffer_out: file segments can only be sent with sendfile()
+   // if they are added to the socket's output buffer directly
+
+   evhtp_send_reply_start(req, status);
+
+   int res= writeBody ? writeBody(bufferevent_get_output(bev)) : done;
+
+   if (res != done)
+      evhtp_request_set_keepalive(req, 0);
+   else
+      bytesOut+= contentLength;
+
+   evhtp_send_reply_end(req);
+
+   state= stDone;
+   return res;
+}
+
 //***************************************************************************
 // stream (sent response payload w/ streaming)
 //***************************************************************************
@@ -111,6 +296,21 @@ int Response::stream(int status, std::istream* stream)
 {
    evbuffer* sendBuffer;
 
+   if (ownedByPool())
+      return fail;
+
+   // the caller owns the stream, so it is read completely before returning
+
+   if (offloading == this && stream && stream->good())
+   {
+      std::unique_ptr<std::stringstream> copy(new std::stringstream);
+
+      *copy << stream->rdbuf();
+      copy->clear();   // failbit, if the stream was empty
+
+      return this->stream(status, std::unique_ptr<std::istream>(copy.release()));
+   }
+
    if (!stream || !stream->good())
    {
       evhtp_send_reply(req, status);
@@ -121,22 +321,25 @@ int Response::stream(int status, std::istream* stream)
 
    // compression, if enabled
 
-#ifdef CEX_WITH_ZLIB
-   if ((flags & fCompression))
+#ifdef CEX_WITH_COMPRESSION
+   if (compressible((size_t)-1))
    {
+      CompressionMode mode= compressionMode(flags);
       evhtp_request* thisReq= req;
 
-      auto onChunk = [&sendBuffer, &thisReq](char* buf, size_t bufLen)
+      auto onChunk = [this, &sendBuffer, &thisReq](char* buf, size_t bufLen)
       { 
+         bytesOut+= bufLen;
+
          evbuffer_add(sendBuffer, buf, bufLen);
          evhtp_send_reply_chunk(thisReq, sendBuffer);
          evbuffer_drain(sendBuffer, bufLen);
       };
 
-      set("Content-Encoding", flags & fCompressGZip ? "gzip" : "deflate");
+      set("Content-Encoding", compressionEncoding(mode));
 
       evhtp_send_reply_chunk_start(req, EVHTP_RES_OK);
-      compress(stream, onChunk, (flags & fCompressGZip) ? cmGZip : cmDeflate);
+      compress(stream, onChunk, mode, &compression);
    }
    else
 #endif
@@ -154,6 +357,7 @@ int Response::stream(int status, std::istream* stream)
          if (bytesRead == 0)
             break;
 
+         bytesOut+= bytesRead;
          evbuffer_add(sendBuffer, ioBuffer, bytesRead);
          evhtp_send_reply_chunk(req, sendBuffer);
          evbuffer_drain(sendBuffer, bytesRead);
@@ -166,6 +370,264 @@ int Response::stream(int status, std::istream* stream)
    return done;
 }
 
+int Response::stream(int status, std::unique_ptr<std::istream> stream)
+{
+   if (state == stDone)
+      return done;
+
+   if (ownedByPool())
+      return fail;
+
+   if (offloading == this)
+   {
+      std::shared_ptr<std::unique_ptr<std::istream>> owned(new std::unique_ptr<std::istream>(std::move(stream)));
+
+      return postOffloaded([this, status, owned]() { this->stream(status, std::move(*owned)); });
+   }
+
+   evhtp_connection_t* conn= evhtp_request_get_connection(req);
+   struct bufferevent* bev= conn ? evhtp_connection_get_bev(conn) : nullptr;
+
+   if (!stream || !stream->good() || !bev)
+   {
+      evhtp_send_reply(req, status);
+      state= stDone;
+      return fail;
+   }
+
+   streaming.reset(new Streaming());
+   streaming->stream= std::move(stream);
+
+   if (!streaming->chunk)
+   {
+      streaming.reset();
+      evhtp_send_reply(req, 500);
+      state= stDone;
+      return fail;
+   }
+
+   // compression, if enabled
+
+#ifdef CEX_WITH_COMPRESSION
+   if (compressible((size_t)-1))
+   {
+      CompressionMode mode= compressionMode(flags);
+
+      streaming->compressor.reset(new Compressor(mode, &compression));
+      set("Content-Encoding", compressionEncoding(mode));
+   }
+#endif
+
+   evhtp_send_reply_chunk_start(req, status);
+   state= stDone;
+
+   // the write callback runs whenever the output buffer drained below the low watermark
+
+   bufferevent_setwatermark(bev, EV_WRITE, CEX_STREAM_LOW_WATERMARK, 0);
+   evhtp_connection_set_hook(conn, evhtp_hook_on_write, (evhtp_hook)Response::sendChunk, this);
+
+   sendChunk(conn, this);
+
+   return done;
+}
+
+//***************************************************************************
+// sendChunk (connection write callback of a streamed response)
+//***************************************************************************
+
+evhtp_res Response::sendChunk(evhtp_connection_t* conn, void* arg)
+{
+   Response* res= (Response*)arg;
+   Streaming* streaming= res->streaming.get();
+
+   if (!streaming)
+      return EVHTP_RES_OK;
+
+   struct evbuffer* output= bufferevent_get_output(evhtp_connection_get_bev(conn));
+   char ioBuffer[IO_BUFFER_SIZE];
+   bool finished= false, failed= false;
+
+   // fill the output buffer up to the high watermark. the rest follows with the next write callbacks
+
+   while (!finished && evbuffer_get_length(output) < CEX_STREAM_HIGH_WATERMARK)
+   {
+      streaming->stream->read(ioBuffer, IO_BUFFER_SIZE);
+
+      size_t bytesRead= streaming->stream->gcount();
+
+      finished= bytesRead < IO_BUFFER_SIZE;
+      failed= streaming->stream->bad();
+
+#ifdef CEX_WITH_COMPRESSION
+      if (streaming->compressor)
+      {
+         struct evbuffer* chunk= streaming->chunk;
+
+         res->compressedIn+= bytesRead;
+
+         if (streaming->compressor->write(ioBuffer, bytesRead, finished, [res, chunk](char* buf, size_t bufLen)
+         {
+            evbuffer_add(chunk, buf, bufLen);
+            res->compressedOut+= bufLen;
+         }) != done)
+         {
+            finished= failed= true;
+         }
+      }
+      else
+#endif
+      {
+         evbuffer_add(streaming->chunk, ioBuffer, bytesRead);
+      }
+
+      // moves the chunk into the output buffer (empty chunks are skipped)
+
+      size_t chunkLen= evbuffer_get_length(streaming->chunk);
+
+      res->bytesOut+= chunkLen;
+
+      evhtp_send_reply_chunk(res->req, streaming->chunk);
+   }
+
+   if (!finished)
+      return EVHTP_RES_OK;
+
+   res->stopStreaming();
+
+   // on errors, don't send the last chunk, so the client can tell the body is incomplete
+
+   if (failed)
+   {
+      evhtp_request_set_keepalive(res->req, 0);
+      evhtp_send_reply_end(res->req);
+   }
+   else
+   {
+      evhtp_send_reply_chunk_end(res->req);
+   }
+
+   return EVHTP_RES_OK;
+}
+
+//***************************************************************************
+// defer (complete the response later, see DeferredResponse)
+//***************************************************************************
+
+DeferredPtr Response::defer()
+{
+   if (deferred)
+      return deferred;
+
+   evhtp_connection_t* conn= req ? evhtp_request_get_connection(req) : nullptr;
+   struct bufferevent* bev= conn ? evhtp_connection_get_bev(conn) : nullptr;
+
+   if (!bev)
+      return DeferredPtr();
+
+   // the handle's event runs on the event loop of the request's worker thread
+
+   DeferredPtr handle(new DeferredResponse(this, bufferevent_get_base(bev)));
+
+   if (!handle->ev)
+      return DeferredPtr();
+
+   deferred= handle;
+
+   return deferred;
+}
+
+//***************************************************************************
+// cancelDeferred (request finished, outstanding handles must not touch it anymore)
+//***************************************************************************
+
+void Response::cancelDeferred()
+{
+   if (!deferred)
+      return;
+
+   deferred->cancel();
+   deferred.reset();
+}
+
+//***************************************************************************
+// stopStreaming (also called if the connection was closed before the end)
+//***************************************************************************
+
+void Response::stopStreaming()
+{
+   if (!streaming)
+      return;
+
+   evhtp_connection_t* conn= req ? evhtp_request_get_connection(req) : nullptr;
+
+   if (conn)
+   {
+      evhtp_connection_unset_hook(conn, evhtp_hook_on_write);
+
+      if (evhtp_connection_get_bev(conn))
+         bufferevent_setwatermark(evhtp_connection_get_bev(conn), EV_WRITE, 0, 0);
+   }
+
+   streaming.reset();
+}
+
+//***************************************************************************
+// sendFile (sent file contents without copying)
+//***************************************************************************
+
+int Response::sendFile(int status, int fd, size_t offset, size_t length)
+{
+   if (fd < 0)
+      return fail;
+
+   if (ownedByPool())
+   {
+      ::close(fd);
+      return fail;
+   }
+
+   if (offloading == this && state != stDone)
+   {
+      // closed if the request is gone before the file could be sent
+
+      std::shared_ptr<int> owned(new int(fd), [](int* p) { if (*p >= 0) ::close(*p); delete p; });
+
+      return postOffloaded([this, status, owned, offset, length]()
+      {
+         int ownedFd= *owned;
+         *owned= -1;
+
+         sendFile(status, ownedFd, offset, length);
+      });
+   }
+
+   if (state == stDone || !length)
+   {
+      ::close(fd);
+      return state == stDone ? done : end(status, 0, nullptr);
+   }
+
+   // the segment owns fd from now on and closes it as soon as the last reference
+   // (ours, or the output buffer's after sending) is gone
+
+   struct evbuffer_file_segment* seg= evbuffer_file_segment_new(fd, offset, length, EVBUF_FS_CLOSE_ON_FREE);
+
+   if (!seg)
+   {
+      ::close(fd);
+      return fail;
+   }
+
+   int res= end(status, length, [seg, length](struct evbuffer* output)
+   {
+      return evbuffer_add_file_segment(output, seg, 0, length) ? (int)fail : (int)done;
+   });
+
+   evbuffer_file_segment_free(seg);
+
+   return res;
+}
+
 //***************************************************************************
 } // namespace cex
 
@@ -0,0 +1,344 @@
+//*************************************************************************
+// File router.cc
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// cex Library Router class implementation
+//*************************************************************************
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <algorithm>
+#include <deque>
+
+#include <cex/core.hpp>
+#include <cex/util.hpp>
+
+namespace cex
+{
+
+//***************************************************************************
+// class Router
+//***************************************************************************
+// compile
+//***************************************************************************
+
+void Router::compile(const std::vector<std::unique_ptr<Middleware>>& wares, bool mergeRegex)
+{
+   std::vector<std::vector<std::string>> patterns(htp_method_UNKNOWN + 1);
+
+   tables.clear();
+   tables.resize(htp_method_UNKNOWN + 1);
+
+   for (size_t i= 0; i < wares.size(); i++)
+   {
+      Middleware* ware= wares[i].get();
+
+      for (size_t m= 0; m < tables.size(); m++)
+      {
+         Table& table= tables[m];
+
+         if (ware->method != na && ware->method != (int)m)
+            continue;
+
+         // no path (or empty contain-path): matches every request of the method.
+         // regex: can't be put into the tree. merged into one automaton per method, or
+         // checked with Middleware::match() one by one
+
+         bool routed= (ware->flags & (Middleware::fMatchCompare|Middleware::fMatchParams))
+            || ((ware->flags & Middleware::fMatchContain) && !ware->path.empty());
+
+         if (!routed && (ware->flags & Middleware::fMatchRegex) && mergeRegex && !ware->rep)
+         {
+            patterns[m].push_back(ware->path);
+            table.regexWares.push_back(i);
+            continue;
+         }
+
+         if (!routed)
+         {
+            table.always.push_back(Entry(i, 0, (ware->flags & Middleware::fMatching) != 0));
+            continue;
+         }
+
+         int node= insert(table, ware->path, ware->flags & Middleware::fMatchParams);
+
+         if (ware->flags & (Middleware::fMatchCompare|Middleware::fMatchParams))
+         {
+            table.nodes[node].exact.push_back(i);
+         }
+         else
+         {
+            table.nodes[node].contain.push_back(i);
+            table.hasContain= true;
+         }
+      }
+   }
+
+   for (size_t m= 0; m < tables.size(); m++)
+   {
+      Table& table= tables[m];
+
+      link(table);
+
+      // merged automaton too big: check each regex middleware on its own
+
+      if (!patterns[m].empty() && !table.regexSet.compile(patterns[m]))
+      {
+         for (size_t i= 0; i < table.regexWares.size(); i++)
+            table.always.push_back(Entry(table.regexWares[i], 0, true));
+
+         table.regexWares.clear();
+         std::sort(table.always.begin(), table.always.end());
+      }
+   }
+
+   compiledCount= wares.size();
+}
+
+//***************************************************************************
+// clear
+//***************************************************************************
+
+void Router::clear()
+{
+   tables.clear();
+   compiledCount= 0;
+}
+
+//***************************************************************************
+// insert (path into method table)
+//***************************************************************************
+
+int Router::insert(Table& table, const std::string& path, bool params)
+{
+   int node= 0;
+
+   for (size_t i= 0; i < path.length(); i++)
+   {
+      unsigned char c= path[i];
+
+      // `:name` segment. the name itself is not part of the tree (see Middleware::paramNames)
+
+      if (params && c == ':' && (!i || path[i-1] == '/'))
+      {
+         while (i+1 < path.length() && path[i+1] != '/')
+            i++;
+
+         if (table.nodes[node].param == na)
+         {
+            int next= table.nodes.size();
+            table.nodes.push_back(Node());
+            table.nodes[node].param= next;
+         }
+
+         node= table.nodes[node].param;
+         continue;
+      }
+
+      int next= child(table.nodes[node], c);
+
+      if (next == na)
+      {
+         next= table.nodes.size();
+         table.nodes.push_back(Node());
+
+         std::vector<std::pair<unsigned char,int>>& children= table.nodes[node].children;
+         std::vector<std::pair<unsigned char,int>>::iterator it= children.begin();
+
+         while (it != children.end() && it->first < c)
+            ++it;
+
+         children.insert(it, std::make_pair(c, next));
+      }
+
+      node= next;
+   }
+
+   return node;
+}
+
+//***************************************************************************
+// link (calculate Aho-Corasick failure links, breadth first)
+//***************************************************************************
+
+void Router::link(Table& table)
+{
+   std::deque<int> queue;
+
+   for (size_t i= 0; i < table.nodes[0].children.size(); i++)
+      queue.push_back(table.nodes[0].children[i].second);
+
+   while (!queue.empty())
+   {
+      int node= queue.front();
+      queue.pop_front();
+
+      for (size_t i= 0; i < table.nodes[node].children.size(); i++)
+      {
+         unsigned char c= table.nodes[node].children[i].first;
+         int target= table.nodes[node].children[i].second;
+         int fail= table.nodes[node].fail;
+         int next;
+
+         while ((next= child(table.nodes[fail], c)) == na && fail)
+            fail= table.nodes[fail].fail;
+
+         table.nodes[target].fail= next != na ? next : 0;
+         table.nodes[target].output= table.nodes[table.nodes[target].fail].contain.size()
+            ? table.nodes[target].fail : table.nodes[table.nodes[target].fail].output;
+
+         queue.push_back(target);
+      }
+   }
+}
+
+//***************************************************************************
+// child
+//***************************************************************************
+
+int Router::child(const Node& node, unsigned char c)
+{
+   // children are sorted; fanout is small, so linear scan with early exit
+
+   for (size_t i= 0; i < node.children.size(); i++)
+   {
+      if (node.children[i].first == c)
+         return node.children[i].second;
+
+      if (node.children[i].first > c)
+         break;
+   }
+
+   return na;
+}
+
+//***************************************************************************
+// lookup
+//***************************************************************************
+
+bool Router::lookup(Request* req, size_t count, std::vector<Entry>& chain, std::vector<StringView>& params)
+{
+   chain.clear();
+   params.clear();
+
+   // middlewares attached after compilation (or not compiled at all): fall back to
+   // evaluating every middleware
+
+   if (count != compiledCount || tables.empty())
+   {
+      for (size_t i= 0; i < count; i++)
+         chain.push_back(Entry(i));
+
+      return false;
+   }
+
+   int method= req->evhtp_method >= 0 && req->evhtp_method < (int)tables.size() ? req->evhtp_method : htp_method_UNKNOWN;
+   const Table& table= tables[method];
+   const unsigned char* url= (const unsigned char*)req->getUrl();
+   const unsigned char* p;
+   int node;
+   StringView captures[CEX_MAX_PATH_PARAMS];
+
+   chain.insert(chain.end(), table.always.begin(), table.always.end());
+
+   // (1) exact/parameterized paths: walk down from the root
+
+   walk(table, 0, (const char*)url, captures, 0, chain, params);
+
+   // (2) regex paths: single scan with the merged automaton
+
+   if (!table.regexWares.empty())
+   {
+      static thread_local std::vector<int> ids;
+
+      ids.clear();
+      table.regexSet.search((const char*)url, ids);
+
+      for (size_t i= 0; i < ids.size(); i++)
+         chain.push_back(Entry(table.regexWares[ids[i]]));
+   }
+
+   // (3) contained paths: single Aho-Corasick scan over the URL
+
+   if (table.hasContain)
+   {
+      for (p= url, node= 0; *p; p++)
+      {
+         int next;
+
+         while ((next= child(table.nodes[node], *p)) == na && node)
+            node= table.nodes[node].fail;
+
+         node= next != na ? next : 0;
+
+         for (int out= table.nodes[node].contain.size() ? node : table.nodes[node].output; out; out= table.nodes[out].output)
+            chain.insert(chain.end(), table.nodes[out].contain.begin(), table.nodes[out].contain.end());
+      }
+   }
+
+   // restore registration order (a contained path can also be found more than once)
+
+   std::stable_sort(chain.begin(), chain.end());
+   chain.erase(std::unique(chain.begin(), chain.end()), chain.end());
+
+   return true;
+}
+
+//***************************************************************************
+// walk (exact and parameterized paths)
+//***************************************************************************
+
+void Router::walk(const Table& table, int node, const char* p, StringView* captures, int depth, 
+      std::vector<Entry>& chain, std::vector<StringView>& params)
+{
+   // follow the static characters until we reach a node which also has a `:name` child.
+   // (such nodes are always located at the beginning of a path segment)
+   // without any parameterized paths this is a plain loop down the tree.
+
+   while (*p && table.nodes[node].param == na)
+   {
+      node= child(table.nodes[node], *p);
+
+      if (node == na)
+         return;
+
+      p++;
+   }
+
+   const Node& n= table.nodes[node];
+
+   if (!*p)
+   {
+      for (size_t i= 0; i < n.exact.size(); i++)
+      {
+         chain.push_back(Entry(n.exact[i], params.size()));
+         params.insert(params.end(), captures, captures + depth);
+      }
+
+      return;
+   }
+
+   // both the static child and the `:name` segment might match. try both, static first
+
+   int next= child(n, *p);
+
+   if (next != na)
+      walk(table, next, p+1, captures, depth, chain, params);
+
+   const char* end= p;
+
+   while (*end && *end != '/')
+      end++;
+
+   if (end == p || depth >= CEX_MAX_PATH_PARAMS)
+      return;
+
+   captures[depth]= StringView(p, end-p);
+   walk(table, n.param, end, captures, depth+1, chain, params);
+}
+
+//***************************************************************************
+} // namespace cex
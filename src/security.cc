@@ -47,6 +47,8 @@ MiddlewareFunction securityHeaders(std::shared_ptr<SecurityOptions> opts)
    {
       SecurityOptions* theOpts = opts.get() ? opts.get() : &defaultOptions;
 
+      // header values are built in the request's arena
+
       // X-DNS-Prefetch-Control
 
       if (theOpts->noDNSPrefetch != na)
@@ -58,7 +60,9 @@ MiddlewareFunction securityHeaders(std::shared_ptr<SecurityOptions> opts)
       {
          if (theOpts->xFrameAllow == xfFrom)
          {
-            std::string from("ALLOW-FROM " + theOpts->xFrameFrom);
+            ArenaString from("ALLOW-FROM ", req->arena());
+
+            from += theOpts->xFrameFrom.c_str();
             res->set("X-Frame-Options", from.c_str());
          }
          else
@@ -71,7 +75,7 @@ MiddlewareFunction securityHeaders(std::shared_ptr<SecurityOptions> opts)
 
       if (theOpts->hpkpMaxAge > 0 && theOpts->hpkpKeys.size())
       {
-         std::string pin;
+         ArenaString pin(req->arena());
          std::vector<std::string>::iterator it= theOpts->hpkpKeys.begin();
          char age[100];
 
@@ -83,7 +87,7 @@ MiddlewareFunction securityHeaders(std::shared_ptr<SecurityOptions> opts)
                pin += "; ";
 
             pin += "pin-sha256=\"";
-            pin += *it;
+            pin += (*it).c_str();
             pin += "\"";
 
             it++;
@@ -98,7 +102,7 @@ MiddlewareFunction securityHeaders(std::shared_ptr<SecurityOptions> opts)
          if (theOpts->hpkpReportUri.length())
          {
             pin += "; report-uri=\"";
-            pin += theOpts->hpkpReportUri;
+            pin += theOpts->hpkpReportUri.c_str();
             pin += "\"";
          }
 
@@ -109,7 +113,7 @@ MiddlewareFunction securityHeaders(std::shared_ptr<SecurityOptions> opts)
 
       if (theOpts->stsMaxAge > 0)
       {
-         std::string sts("max-age=");
+         ArenaString sts("max-age=", req->arena());
          char age[100];
 
          sprintf(age, "%d", theOpts->stsMaxAge);
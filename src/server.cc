@@ -10,9 +10,16 @@
 // includes
 //***************************************************************************
 
+#include <algorithm>
 #include <iostream>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 #include <cex/core.hpp>
+#include <cex/metrics.hpp>
 #include <cex/ssl.hpp>
 #include <cex/util.hpp>
 
@@ -28,6 +35,52 @@ namespace cex
 bool Server::initialized= false;
 std::mutex Server::initMutex;
 std::unique_ptr<MimeTypes> Server::mimeTypes(new MimeTypes);
+std::unique_ptr<std::unordered_map<std::string,bool>> Server::binaryMimeTypes(new std::unordered_map<std::string,bool>);
+
+// free list of request contexts. a connection is always served by the same worker
+// thread, so contexts are taken (handleHeaders) and returned (handleFinished) within
+// one thread and need no locking.
+
+struct ContextPool
+{
+   ~ContextPool()
+   {
+      for (size_t i= 0; i < contexts.size(); i++)
+         delete contexts[i];
+   }
+
+   std::vector<Server::Context*> contexts;
+};
+
+static thread_local ContextPool contextPool;
+
+// state of an offloaded middleware function (Context::offloadState)
+
+enum OffloadState
+{
+   osNone,
+   osQueued,         // submitted to the offload pool
+   osRunning,        // function runs on a pool thread
+   osPosted,         // function returned, offloadDone is pending on the event loop
+   osDispatching,    // offloadDone runs the posted response functions
+   osAbandoned       // request finished meanwhile, the context is released by the job/offloadDone
+};
+
+// copy of a request an offloaded function works on. the evhtp request is freed as
+// soon as the request is finished, which may happen while the function still runs.
+// headers set by the function are collected here, too (see Server::attach).
+
+struct Server::Detached
+{
+   Detached(evhtp_request_t* original);
+   ~Detached();
+
+   evhtp_request_t* original;
+   evhtp_request_t req;
+   evhtp_uri_t uri;
+   evhtp_path_t path;
+   std::string full, dir, file;
+};
 
 const char* getLibraryVersion()
 {
@@ -54,6 +107,7 @@ Server::Server()
 
 Server::~Server() 
 {
+   stopReactors();
 }
 
 //***************************************************************************
@@ -115,6 +169,53 @@ int Server::start(bool block)
    if (started)
       throw std::runtime_error("Server already started");
 
+   // compile the routing tables from all middlewares attached so far
+
+   router.compile(middleWares, serverConfig.mergeRegexRoutes);
+
+   // CPU-heavy middlewares run on a separate thread pool, so they don't block the event loops
+
+   for (size_t i= 0; i < middleWares.size() && !offloadPool; i++)
+   {
+      if (middleWares[i]->flags & Middleware::fOffload)
+         offloadPool.reset(new Executor(serverConfig.offloadThreadCount > 0 ? serverConfig.offloadThreadCount : 0));
+   }
+
+   // one latency histogram per distinct middleware path. requests not handled by a middleware
+   // with a path (e.g. only by general ones) are counted for "*"
+
+   metrics.reset();
+   routeOfWare.clear();
+
+   if (serverConfig.metrics)
+   {
+      std::vector<std::string> routes(1, "*");
+      std::vector<std::string> wares;
+
+      for (size_t i= 0; i < middleWares.size(); i++)
+      {
+         const std::string& path= middleWares[i]->path;
+         size_t route= 0;
+
+         wares.push_back(path);
+
+         if (!path.empty())
+         {
+            route= std::find(routes.begin(), routes.end(), path) - routes.begin();
+
+            if (route == routes.size())
+               routes.push_back(path);
+         }
+
+         routeOfWare.push_back(route);
+      }
+
+      metrics.reset(new Metrics(routes, wares));
+   }
+
+   if (serverConfig.reactorCount > 0)
+      return startReactors(block);
+
    std::runtime_error err("");
 
    auto startFunc= [this, &block, &err]()
@@ -134,29 +235,8 @@ int Server::start(bool block)
       if (!httpServer)
          throw std::runtime_error("Failed to create new evhtp.");
 
-#ifdef CEX_WITH_SSL
-      if (serverConfig.sslEnabled)
-      {
-         if (serverConfig.sslVerifyMode) 
-         {
-            serverConfig.sslConfig->verify_peer= serverConfig.sslVerifyMode;
-            serverConfig.sslConfig->x509_verify_cb = Server::verifyCert;
-         }
-
-         evhtp_ssl_init(httpServer.get(), serverConfig.sslConfig);
-      }
-#endif
-
-      // attach static request callback function, init number of threads, bind socket
-      // DONT use evhtp_set_gencb, because we need the return-cb to attach the
-      // evhtp_hook_on_headers callback function HERE.
-
-      //evhtp_set_gencb(httpServer.get(), Server::handleRequest, this);
-
-      auto cb= evhtp_set_cb(httpServer.get(), "", Server::handleRequest, this);
-
-      evhtp_callback_set_hook(cb, evhtp_hook_on_headers, (evhtp_hook)Server::handleHeaders, this);
-      evhtp_bind_socket(httpServer.get(), serverConfig.address.c_str(), serverConfig.port, 128);
+      setup(httpServer.get());
+      evhtp_bind_socket(httpServer.get(), serverConfig.address.c_str(), serverConfig.port, serverConfig.backlog);
 
       // function 'evhtp_use_threads' is marked deprecated, but according to libevhtp source
       // the function which should be used now (evhtp_use_threads_wexit) will be renamed to evhtp_use_threads at some point o_O
@@ -215,12 +295,159 @@ int Server::start(bool block)
    return success;
 }
 
+//***************************************************************************
+// setup (SSL, callbacks of a single evhtp instance)
+//***************************************************************************
+
+void Server::setup(evhtp_t* httpServer)
+{
+#ifdef CEX_WITH_SSL
+   if (serverConfig.sslEnabled)
+   {
+      if (serverConfig.sslVerifyMode) 
+      {
+         serverConfig.sslConfig->verify_peer= serverConfig.sslVerifyMode;
+         serverConfig.sslConfig->x509_verify_cb = Server::verifyCert;
+      }
+
+      evhtp_ssl_init(httpServer, serverConfig.sslConfig);
+   }
+#endif
+
+   // attach static request callback function
+   // DONT use evhtp_set_gencb, because we need the return-cb to attach the
+   // evhtp_hook_on_headers callback function HERE.
+
+   //evhtp_set_gencb(httpServer, Server::handleRequest, this);
+
+   auto cb= evhtp_set_cb(httpServer, "", Server::handleRequest, this);
+
+   evhtp_callback_set_hook(cb, evhtp_hook_on_headers, (evhtp_hook)Server::handleHeaders, this);
+
+   // count open connections
+
+   if (metrics)
+      evhtp_set_post_accept_cb(httpServer, Server::handleAccept, this);
+}
+
+//***************************************************************************
+// start reactors (multi-reactor mode)
+//***************************************************************************
+
+int Server::startReactors(bool block)
+{
+   // one event_base + evhtp instance per reactor, each with its own listener socket bound
+   // with SO_REUSEPORT, so the kernel distributes incoming connections among the reactors.
+   // requests are processed within the reactor's thread, no handoff to worker threads.
+
+#ifndef EVHTP_FLAG_ENABLE_REUSEPORT
+   if (serverConfig.reactorCount > 1)
+      throw std::runtime_error("libevhtp was built without SO_REUSEPORT support.");
+#endif
+
+   // create & bind all reactors first, so errors are reported before any thread runs
+
+   std::unique_lock<std::mutex> lock(reactorMutex);
+
+   for (int i= 0; i < serverConfig.reactorCount; i++)
+   {
+      std::unique_ptr<Reactor> reactor(new Reactor);
+
+      reactor->eventBase= EventBasePtr(event_base_new(), &event_base_free);
+
+      if (!reactor->eventBase)
+      {
+         reactors.clear();
+         throw std::runtime_error("Failed to create new base_event.");
+      }
+
+      reactor->httpServer= HttpServerPtr(evhtp_new(reactor->eventBase.get(), NULL), &evhtp_free);
+
+      if (!reactor->httpServer)
+      {
+         reactors.clear();
+         throw std::runtime_error("Failed to create new evhtp.");
+      }
+
+      setup(reactor->httpServer.get());
+
+#ifdef EVHTP_FLAG_ENABLE_REUSEPORT
+      evhtp_enable_flag(reactor->httpServer.get(), EVHTP_FLAG_ENABLE_REUSEPORT);
+#endif
+
+      if (evhtp_bind_socket(reactor->httpServer.get(), serverConfig.address.c_str(), serverConfig.port, serverConfig.backlog) < 0)
+      {
+         reactors.clear();
+         throw std::runtime_error("Failed to bind listener socket.");
+      }
+
+      reactors.push_back(std::move(reactor));
+   }
+
+   auto runFunc= [this](int index)
+   {
+#ifdef __linux__
+      if (serverConfig.pinReactors)
+      {
+         unsigned int cpus= std::thread::hardware_concurrency();
+         cpu_set_t set;
+
+         CPU_ZERO(&set);
+         CPU_SET(cpus ? index % cpus : 0, &set);
+         pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+      }
+#endif
+
+      // this BLOCKS the current thread
+
+      event_base_loop(reactors[index]->eventBase.get(), 0);
+      evhtp_unbind_socket(reactors[index]->httpServer.get());
+   };
+
+   // in blocking mode, the first reactor runs in the calling thread
+
+   for (size_t i= block ? 1 : 0; i < reactors.size(); i++)
+      reactors[i]->thread= std::thread(runFunc, (int)i);
+
+   started= true;
+
+   lock.unlock();
+
+   if (block)
+   {
+      runFunc(0);
+
+      // stopped: wait for the other reactors. stop() may still be iterating the
+      // reactors in the stopping thread, so they are freed under the lock
+
+      for (size_t i= 1; i < reactors.size(); i++)
+         reactors[i]->thread.join();
+
+      offloadPool.reset();
+
+      lock.lock();
+      reactors.clear();
+   }
+
+   return success;
+}
+
 //***************************************************************************
 // stop
 //***************************************************************************
 
 int Server::stop()
 {
+   bool multiReactor;
+
+   {
+      std::lock_guard<std::mutex> lock(reactorMutex);
+      multiReactor= !reactors.empty();
+   }
+
+   if (multiReactor)
+      return stopReactors();
+
    if (!eventBase || !started)
       return done;
 
@@ -231,6 +458,46 @@ int Server::stop()
    else
       event_base_loopexit(eventBase.get(), NULL); 
 
+   // runs the jobs still queued. the event base stays until the next start.
+
+   offloadPool.reset();
+
+   started= startSignaled= false;
+
+   return done;
+}
+
+//***************************************************************************
+// stop reactors
+//***************************************************************************
+
+int Server::stopReactors()
+{
+   std::lock_guard<std::mutex> lock(reactorMutex);
+
+   if (!started || reactors.empty())
+      return done;
+
+   // in blocking mode, the thread which called listen() waits for the reactors and cleans up
+
+   bool background= reactors[0]->thread.joinable();
+
+   // safe to call from different thread context, see above
+
+   for (size_t i= 0; i < reactors.size(); i++)
+      event_base_loopexit(reactors[i]->eventBase.get(), NULL);
+
+   if (background)
+   {
+      for (size_t i= 0; i < reactors.size(); i++)
+         reactors[i]->thread.join();
+
+      // before the event bases are freed, the pool's jobs post to them
+
+      offloadPool.reset();
+      reactors.clear();
+   }
+
    started= startSignaled= false;
 
    return done;
@@ -465,7 +732,21 @@ evhtp_res Server::handleHeaders(evhtp_request_t* request, evhtp_headers_t* hdr,
    // holds the request, response and server pointers.
 
    Server* serv= (Server*)arg;
-   Server::Context* ctx= new Server::Context(request, serv);
+   Server::Context* ctx;
+
+   if (!contextPool.contexts.empty())
+   {
+      ctx= contextPool.contexts.back();
+      contextPool.contexts.pop_back();
+      ctx->reset(request, serv);
+   }
+   else
+   {
+      ctx= new Server::Context(request, serv);
+   }
+
+   if (serv->metrics)
+      ctx->begin= std::chrono::steady_clock::now();
 
    // add hooks for body upload & finish of request. 'handleRequest' was already registered
    // in Server::listen
@@ -473,6 +754,40 @@ evhtp_res Server::handleHeaders(evhtp_request_t* request, evhtp_headers_t* hdr,
    evhtp_request_set_hook(request, evhtp_hook_on_read, (evhtp_hook)Server::handleBody, ctx); 
    evhtp_request_set_hook(request, evhtp_hook_on_request_fini, (evhtp_hook)Server::handleFinished, ctx); 
 
+   // resolve the upload middleware (if any) once, instead of matching it for every body chunk
+
+   for (size_t i= 0; i < serv->uploadWares.size(); i++)
+   {
+      if (serv->uploadWares[i].get()->match(ctx->req.get()))
+      {
+         ctx->uploadWare= serv->uploadWares[i].get();
+         break;
+      }
+   }
+
+   // announced body size. used to reserve the body buffer once, and to reject
+   // too large requests before any body data is buffered
+
+   const char* contentLength= evhtp_header_find(hdr, "Content-Length");
+
+   if (contentLength)
+      ctx->contentLength= strtoull(contentLength, 0, 10);
+
+   if (serv->serverConfig.maxBodySize && ctx->contentLength > serv->serverConfig.maxBodySize)
+   {
+      // reply right away and close the connection once the reply is sent. don't let
+      // libevhtp send a '100 Continue' after our reply.
+
+      evhtp_kv_t* expect= evhtp_kvs_find_kv(hdr, "Expect");
+
+      if (expect)
+         evhtp_kv_rm_and_free(hdr, expect);
+
+      ctx->rejected= true;
+      evhtp_request_set_keepalive(request, 0);
+      evhtp_send_reply(request, EVHTP_RES_DATA_TOO_LONG);
+   }
+
    return EVHTP_RES_OK;
 }
 
@@ -491,45 +806,79 @@ evhtp_res Server::handleBody(evhtp_request_t* req, struct evbuffer* buf, void* a
    size_t bytesReady= evbuffer_get_length(buf);
    size_t oldSize= body->size();
 
-   // (1) check if we have attached upload middleware(s)
+   // (0) body too large: discard announced body, abort if the limit is exceeded while receiving
+
+   if (ctx->rejected)
+   {
+      evbuffer_drain(buf, bytesReady);
+      return EVHTP_RES_OK;
+   }
+
+   ctx->bodyBytes += bytesReady;
+
+   if (ctx->serv->serverConfig.maxBodySize && ctx->bodyBytes > ctx->serv->serverConfig.maxBodySize)
+      return EVHTP_RES_DATA_TOO_LONG;
 
-   if (ctx->serv->uploadWares.size())
+   // (1) upload middleware (resolved in handleHeaders). pass the buffer's segments
+   // without copying, then drain them
+
+   if (ctx->uploadWare)
    {
-      std::vector<std::unique_ptr<Middleware>>::iterator it= ctx->serv->uploadWares.begin();
+      static thread_local std::vector<struct evbuffer_iovec> segments;
+      Middleware* ware= ctx->uploadWare;
+      int n= evbuffer_peek(buf, -1, 0, 0, 0);
 
-      while (it != ctx->serv->uploadWares.end())
+      if (n > 0)
       {
-         if (!((*it).get()->match(ctx->req.get())))
-         {
-            ++it;
-            continue;
-         }
+         segments.resize(n);
+         n= evbuffer_peek(buf, -1, 0, segments.data(), n);
+      }
 
-         // we found a matching upload ware. copy bytes into body buffer (CURRENT CHUNK ONLY)
-         // and call the upload middleware function.
+      ctx->req.get()->middlewarePath= ware->getPath();
 
-         body->resize(bytesReady);
+      for (int i= 0; i < n; i++)
+         ware->uploadFunc(ctx->req.get(), (const char*)segments[i].iov_base, segments[i].iov_len);
 
-         if (body->size() < bytesReady)
-         {
-            // allocation error
+      evbuffer_drain(buf, bytesReady);
 
-            return EVHTP_RES_500;
-         }
+      return EVHTP_RES_OK;
+   }
 
-         ev_ssize_t bytesCopied= evbuffer_copyout(buf, (void*)(body->data()), bytesReady);
+   // (2a) no upload middleware attached, or none matched. zero-copy mode: move the buffers
+   // into the request's chain (also drains `buf`, so libevhtp won't copy it into req->buffer_in)
 
+   if (ctx->serv->serverConfig.zeroCopyBody)
+   {
+      Request* request= ctx->req.get();
 
-         ctx->req.get()->middlewarePath= (*it).get()->getPath();
-         (*it).get()->uploadFunc(ctx->req.get(), body->data(), bytesCopied);
+      if (!request->bodyBuffer && !(request->bodyBuffer= evbuffer_new()))
+         return EVHTP_RES_500;
 
-         return EVHTP_RES_OK;
-      }
+      if (evbuffer_add_buffer(request->bodyBuffer, buf))
+         return EVHTP_RES_500;
+
+      return EVHTP_RES_OK;
    }
 
-   // (2) no upload middleware attached, or none matched. just copy bytes into (full) body buffer
+   // (2b) copy bytes into (full) body buffer. reserve the announced size with the first chunk. the
+   // client's Content-Length is not trusted beyond the limit (or the pooled buffer size), the buffer
+   // grows as usual if more data arrives. allocation errors must not pass the libevhtp callback.
+
+   try
+   {
+      if (!oldSize && ctx->contentLength > bytesReady)
+      {
+         size_t limit= ctx->serv->serverConfig.maxBodySize ? ctx->serv->serverConfig.maxBodySize : (size_t)CEX_CONTEXT_POOL_MAX_BODY;
+
+         body->reserve(std::min(ctx->contentLength, limit));
+      }
 
-   body->resize(bytesReady + oldSize);
+      body->resize(bytesReady + oldSize);
+   }
+   catch (const std::exception&)
+   {
+      return EVHTP_RES_500;
+   }
 
    if (body->size() < (bytesReady + oldSize))
    {
@@ -567,6 +916,11 @@ void Server::handleRequest(evhtp_request* req, void* arg)
       return;
    }
 
+   // already answered (body too large)
+
+   if (ctx->rejected)
+      return;
+
    // retrieve SSL client info (certificate), if available & configured
 
 #ifdef CEX_WITH_SSL
@@ -576,76 +930,507 @@ void Server::handleRequest(evhtp_request* req, void* arg)
 
    // enable compression, if available & configured
 
-#ifdef CEX_WITH_ZLIB
+#ifdef CEX_WITH_COMPRESSION
+   ctx->res.get()->compression.level= ctx->serv->serverConfig.compressLevel;
+   ctx->res.get()->compression.memLevel= ctx->serv->serverConfig.compressMemLevel;
+   ctx->res.get()->compression.windowBits= ctx->serv->serverConfig.compressWindowBits;
+   ctx->res.get()->compression.brotliQuality= ctx->serv->serverConfig.compressBrotliQuality;
+   ctx->res.get()->compression.zstdLevel= ctx->serv->serverConfig.compressZstdLevel;
+   ctx->res.get()->compression.minBytes= ctx->serv->serverConfig.compressMinBytes;
+
    if (ctx->serv->serverConfig.compress)
    {
-      const char* acceptEncoding= ctx->req.get()->get("Accept-Encoding");
+      // whether the body is compressed is decided when it is sent (size, content type),
+      // but any response may differ by Accept-Encoding
+
+      CompressionMode mode= negotiateCompression(ctx->req.get()->get("Accept-Encoding"));
+
+      static const int modeFlags[cmCount]= { Response::fCompressDeflate, Response::fCompressGZip, Response::fCompressBrotli, Response::fCompressZstd };
 
-      if (acceptEncoding && strstr(acceptEncoding, "gzip"))
-         ctx->res.get()->setFlags(ctx->res.get()->getFlags() | Response::fCompressGZip);
-      else if (acceptEncoding && strstr(acceptEncoding, "deflate"))
-         ctx->res.get()->setFlags(ctx->res.get()->getFlags() | Response::fCompressDeflate);
+      if (mode != cmUnknown)
+         ctx->res.get()->setFlags(ctx->res.get()->getFlags() | modeFlags[mode]);
+
+      ctx->res.get()->set("Vary", "Accept-Encoding");
    }
 #endif
 
    // call all registered handlers (route-based and general middlewares)
 
-   std::vector<std::unique_ptr<Middleware>>::iterator it= ctx->serv->middleWares.begin();
-
-   if (ctx->serv->middleWares.size())
-      it = ctx->serv->middleWares.begin();
-
-   if (!ctx->serv->middleWares.size() || it == ctx->serv->middleWares.end())
+   if (!ctx->serv->middleWares.size())
    {
       ctx->res.get()->end(404);
       return;
    }
 
-   std::function<void()> next;
+   // let the router collect the candidate middlewares (in registration order), then run the
+   // first matching one. if no middleware matched, the request will hang (thats intended).
+
+   Chain& chain= ctx->chain;
+   bool routed= ctx->serv->router.lookup(ctx->req.get(), ctx->serv->middleWares.size(), chain.entries, chain.params);
+
+   chain.metrics= ctx->serv->metrics.get();
+   chain.start(&ctx->serv->middleWares, ctx->req.get(), ctx->res.get(), routed);
+}
+
+//***************************************************************************
+// handle finished (step 4)
+//***************************************************************************
+
+evhtp_res Server::handleFinished(evhtp_request_t* req, void* arg)
+{
+   // forget the request context we created (keep it for the next request, if possible)
+
+   Server::Context* ctx= (Server::Context*)arg;
+   bool abandoned= false;
+
+   bool running= false;
 
-   // create next-function to be handed to each middleware
+   // an offloaded middleware function may still use the request (it works on a copy, see
+   // Server::detach). the context is released once it returned and its response is dropped.
 
-   next = [&next, &ctx, &it]()
    {
-      ++it;
+      std::lock_guard<std::mutex> lock(ctx->offloadMutex);
 
-      if (it != ctx->serv->middleWares.end())
+      if (ctx->offloadState != osNone)
       {
-         if ((*it).get()->match(ctx->req.get()))
-         {
-            ctx->req.get()->middlewarePath= (*it).get()->getPath();
-            (*it).get()->func(ctx->req.get(), ctx->res.get(), next);
-         }
-         else
-            next();
+         running= ctx->offloadState == osRunning;
+         ctx->offloadState= osAbandoned;
+         abandoned= true;
       }
-   };
+   }
+
+   // a streamed response may still be running if the connection was closed early
+   // (a running function may use the response, runOffloaded cleans up after it)
+
+   if (!running)
+   {
+      ctx->res.get()->stopStreaming();
+      ctx->res.get()->cancelDeferred();
+   }
+
+   if (ctx->serv->metrics)
+      recordMetrics(ctx, req);
+
+   if (!abandoned)
+      releaseContext(ctx);
+   
+   return EVHTP_RES_OK;
+}
+
+//***************************************************************************
+// record metrics (finished request)
+//***************************************************************************
+
+void Server::recordMetrics(Context* ctx, evhtp_request_t* req)
+{
+   Metrics* metrics= ctx->serv->metrics.get();
+   Response* res= ctx->res.get();
+   int routeWare= ctx->chain.routeWare;
+   size_t route= routeWare >= 0 && (size_t)routeWare < ctx->serv->routeOfWare.size() ? ctx->serv->routeOfWare[routeWare] : 0;
+   long long micros= std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - ctx->begin).count();
 
-   // call next handler OR next-function, if next handler doesnt match.
-   // if no middleware matched, the request will hang (thats intended).
+   metrics->add(Metrics::mcRequests);
+   metrics->add(Metrics::mcBytesIn, ctx->bodyBytes);
+   metrics->add(Metrics::mcBytesOut, res->bytesOut);
 
-   if ((*it).get()->match(ctx->req.get()))
+   if (res->compressedIn)
    {
-      ctx->req.get()->middlewarePath= (*it).get()->getPath();
-      (*it).get()->func(ctx->req.get(), ctx->res.get(), next);
+      metrics->add(Metrics::mcCompressedIn, res->compressedIn);
+      metrics->add(Metrics::mcCompressedOut, res->compressedOut);
    }
+
+   // no status if the connection was closed before a reply was sent
+
+   if (req && req->status)
+      metrics->addStatus(req->status);
+
+   metrics->addLatency(route, micros > 0 ? (uint64_t)micros : 0);
+}
+
+//***************************************************************************
+// handle accept/connection closed (metrics)
+//***************************************************************************
+
+evhtp_res Server::handleAccept(evhtp_connection_t* conn, void* arg)
+{
+   Server* serv= (Server*)arg;
+
+   serv->metrics->add(Metrics::mcConnectionsOpened);
+   evhtp_connection_set_hook(conn, evhtp_hook_on_connection_fini, (evhtp_hook)Server::handleConnectionClosed, serv);
+
+   return EVHTP_RES_OK;
+}
+
+evhtp_res Server::handleConnectionClosed(evhtp_connection_t* conn, void* arg)
+{
+   Server* serv= (Server*)arg;
+
+   if (serv->metrics)
+      serv->metrics->add(Metrics::mcConnectionsClosed);
+
+   return EVHTP_RES_OK;
+}
+
+//***************************************************************************
+// get metrics
+//***************************************************************************
+
+MetricsSnapshot Server::getMetrics()
+{
+   return metrics ? metrics->snapshot() : MetricsSnapshot();
+}
+
+//***************************************************************************
+// release context (worker thread)
+//***************************************************************************
+
+void Server::releaseContext(Context* ctx)
+{
+   ctx->res.get()->offloadOps.clear();
+   ctx->offloadState= osNone;
+
+   delete ctx->detached;
+   ctx->detached= nullptr;
+
+   // free all temporary memory of the request at once
+
+   ctx->req.get()->arena().reset();
+
+   if (contextPool.contexts.size() < CEX_CONTEXT_POOL_SIZE)
+      contextPool.contexts.push_back(ctx);
    else
-      next();
+      delete ctx;
 }
 
 //***************************************************************************
-// handle finished (step 4)
+// offload (middleware attached with Middleware::fOffload)
 //***************************************************************************
 
-evhtp_res Server::handleFinished(evhtp_request_t* req, void* arg)
+bool Server::offload(Context* ctx, Middleware* ware)
 {
-   // forget the request context we created
+   Executor* pool= ctx->serv->offloadPool.get();
+   evhtp_connection_t* conn= pool ? evhtp_request_get_connection(ctx->res.get()->req) : nullptr;
+   struct bufferevent* bev= conn ? evhtp_connection_get_bev(conn) : nullptr;
+
+   if (!bev)
+      return false;
+
+   // the function's response is sent by the event loop owning the connection
+
+   struct event_base* base= bufferevent_get_base(bev);
+
+   detach(ctx);
+
+   {
+      std::lock_guard<std::mutex> lock(ctx->offloadMutex);
+      ctx->offloadState= osQueued;
+   }
+
+   pool->submit([ctx, ware, base]() { Server::runOffloaded(ctx, ware, base); });
+
+   return true;
+}
+
+//***************************************************************************
+// run offloaded (pool thread)
+//***************************************************************************
+
+void Server::runOffloaded(Context* ctx, Middleware* ware, struct event_base* base)
+{
+   bool abandoned;
+
+   {
+      std::lock_guard<std::mutex> lock(ctx->offloadMutex);
+
+      abandoned= ctx->offloadState == osAbandoned;
+      ctx->offloadState= osRunning;
+   }
+
+   // the request was finished before the function could run, so the context is ours
+
+   if (abandoned)
+   {
+      delete ctx;
+      return;
+   }
+
+   // sending the response and next() are collected, and run by the event loop afterwards (see offloadDone)
+
+   Response::offloading= ctx->res.get();
 
+#ifdef CEX_WITH_CHAIN_TIMING
+   Metrics* metrics= ctx->chain.metrics;
+   std::chrono::steady_clock::time_point begin;
+
+   if (metrics)
+      begin= std::chrono::steady_clock::now();
+#endif
+
+   ware->func(ctx->req.get(), ctx->res.get(), Next(&ctx->chain));
+
+#ifdef CEX_WITH_CHAIN_TIMING
+   // the chain is idle while the function runs (next() is posted), so it still knows the middleware
+
+   if (metrics)
+      metrics->addMiddlewareTime(ctx->chain.calledWare, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+#endif
+
+   Response::offloading= nullptr;
+
+   {
+      std::lock_guard<std::mutex> lock(ctx->offloadMutex);
+
+      abandoned= ctx->offloadState == osAbandoned;
+
+      if (!abandoned)
+         ctx->offloadState= osPosted;
+   }
+
+   // the request was finished while the function ran, so its response is dropped
+
+   if (abandoned)
+   {
+      ctx->res.get()->cancelDeferred();
+      delete ctx;
+      return;
+   }
+
+   struct timeval now= { 0, 0 };
+
+   event_base_once(base, -1, EV_TIMEOUT, Server::offloadDone, ctx, &now);
+}
+
+//***************************************************************************
+// offload done (worker thread)
+//***************************************************************************
+
+void Server::offloadDone(evutil_socket_t fd, short what, void* arg)
+{
    Server::Context* ctx= (Server::Context*)arg;
+   std::vector<std::function<void()>> ops;
+   bool abandoned;
 
-   delete ctx;
-   
-   return EVHTP_RES_OK;
+   {
+      std::lock_guard<std::mutex> lock(ctx->offloadMutex);
+
+      abandoned= ctx->offloadState == osAbandoned;
+
+      if (!abandoned)
+         ctx->offloadState= osDispatching;
+   }
+
+   // the response goes to the evhtp request again (with the headers set by the function)
+
+   if (!abandoned)
+      attach(ctx);
+
+   ops.swap(ctx->res.get()->offloadOps);
+
+   // the request may be finished by one of the functions (handleFinished abandons the context then)
+
+   for (size_t i= 0; i < ops.size(); i++)
+   {
+      {
+         std::lock_guard<std::mutex> lock(ctx->offloadMutex);
+
+         if (ctx->offloadState == osAbandoned)
+            break;
+      }
+
+      ops[i]();
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(ctx->offloadMutex);
+
+      if (ctx->offloadState == osDispatching)
+      {
+         ctx->offloadState= osNone;
+         return;
+      }
+
+      if (ctx->offloadState != osAbandoned)
+         return;
+   }
+
+   releaseContext(ctx);
+}
+
+//***************************************************************************
+// detach (worker thread, before an offloaded function is submitted)
+//***************************************************************************
+
+void Server::detach(Context* ctx)
+{
+   evhtp_request_t* req= ctx->res.get()->req;
+   Detached* detached= new Detached(req);
+
+   delete ctx->detached;
+   ctx->detached= detached;
+
+   // path parameters must stay valid if the evhtp request is freed meanwhile
+
+   if (req->uri && req->uri->path && req->uri->path->full)
+      rebaseParams(ctx, req->uri->path->full, detached->path.full);
+
+   ctx->req.get()->req= &detached->req;
+   ctx->req.get()->uri= detached->req.uri ? detached->req.uri->path : nullptr;
+   ctx->req.get()->authority= nullptr;
+   ctx->res.get()->req= &detached->req;
+   ctx->res.get()->offloaded= true;
+}
+
+//***************************************************************************
+// attach (worker thread, offloaded function returned)
+//***************************************************************************
+
+void Server::attach(Context* ctx)
+{
+   Detached* detached= ctx->detached;
+
+   if (!detached)
+      return;
+
+   evhtp_request_t* req= detached->original;
+
+   // the headers set by the function replace the ones of the evhtp request (the copy frees the old ones)
+
+   std::swap(req->headers_out, detached->req.headers_out);
+
+   if (req->uri && req->uri->path && req->uri->path->full)
+      rebaseParams(ctx, detached->path.full, req->uri->path->full);
+
+   ctx->req.get()->req= req;
+   ctx->req.get()->uri= req->uri ? req->uri->path : nullptr;
+   ctx->req.get()->authority= req->uri ? req->uri->authority : nullptr;
+   ctx->res.get()->req= req;
+   ctx->res.get()->offloaded= false;
+
+   ctx->detached= nullptr;
+   delete detached;
+}
+
+//***************************************************************************
+// rebase params (path parameter values point into the request's URL)
+//***************************************************************************
+
+void Server::rebaseParams(Context* ctx, const char* from, const char* to)
+{
+   if (!from || !to)
+      return;
+
+   size_t length= strlen(from);
+   std::vector<StringView>& params= ctx->chain.params;
+
+   for (size_t i= 0; i < params.size(); i++)
+   {
+      const char* p= params[i].data();
+
+      if (p && p >= from && p <= from + length)
+         params[i]= StringView(to + (p - from), params[i].size());
+   }
+}
+
+//***************************************************************************
+// class Server::Detached
+//***************************************************************************
+// ctor/dtor
+//***************************************************************************
+
+static int copyKeyValue(evhtp_kv_t* kv, void* arg)
+{
+   evhtp_kv_t* copy= evhtp_kv_new(kv->key, kv->val, 1, 1);
+
+   if (copy)
+      evhtp_kvs_add_kv((evhtp_kvs_t*)arg, copy);
+
+   return 0;
+}
+
+static evhtp_kvs_t* copyKeyValues(evhtp_kvs_t* kvs)
+{
+   evhtp_kvs_t* copy= kvs ? evhtp_kvs_new() : nullptr;
+
+   if (copy)
+      evhtp_kvs_for_each(kvs, copyKeyValue, copy);
+
+   return copy;
+}
+
+Server::Detached::Detached(evhtp_request_t* aOriginal)
+   : original(aOriginal), req(*aOriginal)
+{
+   memset(&uri, 0, sizeof(uri));
+   memset(&path, 0, sizeof(path));
+
+   // without a connection, nothing can be sent (the response functions are posted anyway)
+
+   req.conn= nullptr;
+   req.hooks= nullptr;
+   req.buffer_in= nullptr;
+   req.buffer_out= nullptr;
+   req.uri= nullptr;
+   req.headers_in= copyKeyValues(original->headers_in);
+   req.headers_out= copyKeyValues(original->headers_out);
+
+   if (!original->uri)
+      return;
+
+   req.uri= &uri;
+   uri.scheme= original->uri->scheme;
+   uri.query= copyKeyValues(original->uri->query);
+
+   if (!original->uri->path)
+      return;
+
+   uri.path= &path;
+
+   if (original->uri->path->full)
+      path.full= &(full= original->uri->path->full)[0];
+
+   if (original->uri->path->path)
+      path.path= &(dir= original->uri->path->path)[0];
+
+   if (original->uri->path->file)
+      path.file= &(file= original->uri->path->file)[0];
+}
+
+Server::Detached::~Detached()
+{
+   if (req.headers_in)
+      evhtp_kvs_free(req.headers_in);
+
+   if (req.headers_out)
+      evhtp_kvs_free(req.headers_out);
+
+   if (uri.query)
+      evhtp_kvs_free(uri.query);
+}
+
+//***************************************************************************
+// class Server::Context
+//***************************************************************************
+// dtor
+//***************************************************************************
+
+Server::Context::~Context()
+{
+   delete detached;
+}
+
+//***************************************************************************
+// reset
+//***************************************************************************
+
+void Server::Context::reset(evhtp_request_t* request, Server* aServ)
+{
+   req.get()->reset(request);
+   res.get()->reset(request);
+   serv= aServ;
+   contentLength= bodyBytes= 0;
+   rejected= false;
+   uploadWare= nullptr;
+   chain.calledWare= chain.routeWare= na;
 }
 
 //***************************************************************************
@@ -658,9 +1443,23 @@ Server::Config::Config()
 { 
    port= na;
    compress= true; 
+   compressMinBytes= 256;
+   compressLevel= -1;
+   compressMemLevel= 8;
+   compressWindowBits= 15;
+   compressBrotliQuality= 4;
+   compressZstdLevel= 3;
    parseSslInfo= true; 
    sslEnabled= false;
+   mergeRegexRoutes= true;
    threadCount= 4; 
+   offloadThreadCount= 0;
+   maxBodySize= 0;
+   zeroCopyBody= false;
+   reactorCount= 0;
+   pinReactors= false;
+   backlog= 128;
+   metrics= true;
 
 #ifdef CEX_WITH_SSL
    sslVerifyMode= 0;
@@ -676,9 +1475,23 @@ Server::Config::Config(Config& other)
 {
    port= na;
    compress= other.compress;
+   compressMinBytes= other.compressMinBytes;
+   compressLevel= other.compressLevel;
+   compressMemLevel= other.compressMemLevel;
+   compressWindowBits= other.compressWindowBits;
+   compressBrotliQuality= other.compressBrotliQuality;
+   compressZstdLevel= other.compressZstdLevel;
    parseSslInfo= other.parseSslInfo;
    sslEnabled= other.sslEnabled;
+   mergeRegexRoutes= other.mergeRegexRoutes;
    threadCount= other.threadCount;
+   offloadThreadCount= other.offloadThreadCount;
+   maxBodySize= other.maxBodySize;
+   zeroCopyBody= other.zeroCopyBody;
+   reactorCount= other.reactorCount;
+   pinReactors= other.pinReactors;
+   backlog= other.backlog;
+   metrics= other.metrics;
 
 #ifdef CEX_WITH_SSL
    sslVerifyMode= other.sslVerifyMode;
@@ -10,6 +10,7 @@
 // includes
 //***************************************************************************
 
+#include <ctype.h>
 #include <time.h>
 
 #include <cex/session.hpp>
@@ -40,30 +41,51 @@ MiddlewareFunction sessionHandler(std::shared_ptr<SessionOptions> opts)
 
       if (cookie)
       {
-	 // split by ; to iterate all contained cookies
+	 // iterate all `name=value` pairs (separated by ;) to find 'our' cookie.
+	 // only the value of the session cookie is copied
 
-	 std::vector<std::string> splitted(splitString(cookie, ';'));
+	 const char* p= cookie;
 
-	 for (std::vector<std::string>::iterator it = splitted.begin(); it != splitted.end(); ++it)
+	 while (*p)
 	 {
-	    std::string cookieName, cookieValue;
-	    std::vector<std::string> cookieContents(splitString((*it).c_str(), '='));
-	    std::vector<std::string>::iterator cookieIt = cookieContents.begin();
+	    const char* name= p;
+	    const char* eq= nullptr;
 
-	    // split again by = to get cookie name & value. then try to find 'our' cookie
-
-	    if (cookieContents.size() && cookieIt != cookieContents.end()) 
+	    while (*p && *p != ';')
 	    {
-	       cookieName= *cookieIt;
-	       ++cookieIt;
+	       if (!eq && *p == '=')
+		  eq= p;
+
+	       p++;
+	    }
+
+	    const char* end= p;
+
+	    if (*p)
+	       p++;
+
+	    if (!eq)
+	       continue;
+
+	    const char* nameEnd= eq;
+	    const char* value= eq+1;
+
+	    while (name < nameEnd && isspace((unsigned char)*name))
+	       name++;
+
+	    while (nameEnd > name && isspace((unsigned char)nameEnd[-1]))
+	       nameEnd--;
 
-	       if (cookieIt != cookieContents.end())
-	       {
-		  cookieValue= *cookieIt;
+	    while (value < end && isspace((unsigned char)*value))
+	       value++;
 
-		  if (!cookieName.compare(sessionIDName))
-		     req->properties.set(sessionIDName, cookieValue);
-	       }
+	    while (end > value && isspace((unsigned char)end[-1]))
+	       end--;
+
+	    if ((size_t)(nameEnd - name) == sessionIDName.length() && !strncmp(name, sessionIDName.c_str(), nameEnd - name))
+	    {
+	       std::string cookieValue(value, end - value);
+	       req->properties.set(sessionIDName, cookieValue);
 	    }
 	 }
       }
@@ -77,13 +99,25 @@ MiddlewareFunction sessionHandler(std::shared_ptr<SessionOptions> opts)
 
          req->properties.set(sessionIDName, newSessionId);
 
-	 std::string setCookie= sessionIDName + "=" + newSessionId;
+	 // temporary string lives in the request's arena
+
+	 ArenaString setCookie(req->arena());
+
+	 setCookie += sessionIDName.c_str();
+	 setCookie += "=";
+	 setCookie += newSessionId.c_str();
 
 	 if (theOpts->domain.length())
-	    setCookie += "; Domain=" + theOpts->domain;
+	 {
+	    setCookie += "; Domain=";
+	    setCookie += theOpts->domain.c_str();
+	 }
 
 	 if (theOpts->path.length())
-	    setCookie += "; Path=" + theOpts->path;
+	 {
+	    setCookie += "; Path=";
+	    setCookie += theOpts->path.c_str();
+	 }
 
 	 if (theOpts->expires > 0)
 	 {
@@ -12,6 +12,8 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
+#include <stdlib.h>
 #include <sstream>
 #include <vector>
 #include <algorithm>
@@ -25,6 +27,14 @@
 #  include <zlib.h>
 #endif
 
+#ifdef CEX_WITH_ZSTD
+#  include <zstd.h>
+#endif
+
+#ifdef CEX_WITH_BROTLI
+#  include <brotli/encode.h>
+#endif
+
 #include <cex/util.hpp>
 #include <cex/core.hpp>
 
@@ -54,6 +64,61 @@ std::vector<std::string> splitString(const char* str, char delim, int doTrim)
    return result;
 }
 
+//***************************************************************************
+// Base64 decoding
+// (credits: https://stackoverflow.com/questions/342409/how-do-i-base64-encode-decode-in-c/41094722#41094722)
+//***************************************************************************
+
+static const int B64index[256] = 
+{ 
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 62, 63, 62, 62, 63, 52, 53, 54, 55,
+   56, 57, 58, 59, 60, 61,  0,  0,  0,  0,  0,  0,  0,  0,  1,  2,  3,  4,  5,  6,
+   7,  8,  9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,  0,
+   0,  0,  0, 63,  0, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+   41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51 
+};
+
+size_t base64DecodedSize(size_t srcLen)
+{
+   return (srcLen + 3) / 4 * 3 + 2;
+}
+
+size_t base64Decode(const char* src, size_t srcLen, char* dest)
+{
+   const unsigned char* p = (const unsigned char*)src;
+   int pad = srcLen > 0 && (srcLen % 4 || p[srcLen - 1] == '=');
+   const size_t L = ((srcLen + 3) / 4 - pad) * 4;
+   size_t j = 0;
+
+   for (size_t i = 0; i < L; i += 4)
+   {
+      int n = B64index[p[i]] << 18 | B64index[p[i + 1]] << 12 | B64index[p[i + 2]] << 6 | B64index[p[i + 3]];
+      dest[j++] = n >> 16;
+      dest[j++] = n >> 8 & 0xFF;
+      dest[j++] = n & 0xFF;
+   }
+
+   // a single remaining character can't form a byte (invalid length), it is ignored
+
+   if (pad && srcLen > L + 1)
+   {
+      int n = B64index[p[L]] << 18 | B64index[p[L + 1]] << 12;
+      dest[j++] = n >> 16;
+
+      if (srcLen > L + 2 && p[L + 2] != '=')
+      {
+         n |= B64index[p[L + 2]] << 6;
+         dest[j++] = n >> 8 & 0xFF;
+      }
+   }
+
+   dest[j] = 0;
+
+   return j;
+}
+
 //***************************************************************************
 // Random string (in hex) 
 //***************************************************************************
@@ -98,148 +163,523 @@ std::string randomStringHex(int len)
    return res;
 }
 
+//***************************************************************************
+// negotiateCompression (Accept-Encoding with q-values, RFC 7231 5.3.4)
+//***************************************************************************
+// returns the available encoding with the highest q-value (on ties in the
+// order zstd, br, gzip, deflate), or cmUnknown if the identity encoding shall be used
+
+CompressionMode negotiateCompression(const char* acceptEncoding)
+{
+   static const struct { const char* name; CompressionMode mode; } codings[]= 
+   {
+#ifdef CEX_WITH_ZSTD
+      { "zstd", cmZstd },
+#endif
+#ifdef CEX_WITH_BROTLI
+      { "br", cmBrotli },
+#endif
 #ifdef CEX_WITH_ZLIB
+      { "gzip", cmGZip }, { "x-gzip", cmGZip }, { "deflate", cmDeflate },
+#endif
+      { nullptr, cmUnknown }
+   };
+
+   static const CompressionMode preference[]= { cmZstd, cmBrotli, cmGZip, cmDeflate };
+
+   double q[cmCount]= { -1.0, -1.0, -1.0, -1.0 };    // per mode, -1: not listed
+   double wildcard= -1.0;
+   const char* p= acceptEncoding;
+
+   if (!p)
+      return cmUnknown;
+
+   while (*p)
+   {
+      while (*p == ' ' || *p == '\t' || *p == ',')
+         p++;
+
+      if (!*p)
+         break;
+
+      const char* name= p;
+
+      while (*p && *p != ',' && *p != ';' && *p != ' ' && *p != '\t')
+         p++;
+
+      size_t nameLen= p - name;
+      double value= 1.0;
+
+      // parameters, only q is of interest
+
+      while (*p && *p != ',')
+      {
+         if (*p == ';')
+         {
+            p++;
+
+            while (*p == ' ' || *p == '\t')
+               p++;
+
+            if ((*p == 'q' || *p == 'Q') && p[1] == '=')
+               value= strtod(p+2, (char**)&p);
+         }
+         else
+         {
+            p++;
+         }
+      }
+
+      if (nameLen == 1 && *name == '*')
+      {
+         wildcard= value;
+         continue;
+      }
+
+      for (size_t i= 0; codings[i].name; i++)
+      {
+         if (strlen(codings[i].name) == nameLen && !strncasecmp(name, codings[i].name, nameLen))
+            q[codings[i].mode]= value > q[codings[i].mode] ? value : q[codings[i].mode];
+      }
+   }
+
+   // the wildcard only applies to encodings which are available, but were not listed
+
+   for (size_t i= 0; codings[i].name; i++)
+   {
+      if (q[codings[i].mode] < 0.0)
+         q[codings[i].mode]= wildcard;
+   }
+
+   CompressionMode best= cmUnknown;
+
+   for (size_t i= 0; i < sizeof(preference)/sizeof(preference[0]); i++)
+   {
+      if (q[preference[i]] > 0.0 && (best == cmUnknown || q[preference[i]] > q[best]))
+         best= preference[i];
+   }
+
+   return best;
+}
+
 //***************************************************************************
-// compress buffer (GZIP or deflate)
+// compressionMode / compressionEncoding
 //***************************************************************************
 
-int compress(const char* src, size_t srcLen, struct evbuffer* dest, CompressionMode compMode)
+CompressionMode compressionMode(int responseFlags)
 {
-   if (!src || !dest)
-      return fail;
+   if (responseFlags & Response::fCompressZstd)
+      return cmZstd;
 
-   int res, flush;
-   size_t bytesRead= 0;
-   char out[IO_BUFFER_SIZE];
+   if (responseFlags & Response::fCompressBrotli)
+      return cmBrotli;
+
+   if (responseFlags & Response::fCompressGZip)
+      return cmGZip;
+
+   if (responseFlags & Response::fCompressDeflate)
+      return cmDeflate;
+
+   return cmUnknown;
+}
+
+const char* compressionEncoding(CompressionMode compMode)
+{
+   switch (compMode)
+   {
+      case cmDeflate: return "deflate";
+      case cmGZip:    return "gzip";
+      case cmBrotli:  return "br";
+      case cmZstd:    return "zstd";
+      default:        break;
+   }
+
+   return nullptr;
+}
 
+#ifdef CEX_WITH_COMPRESSION
+static const CompressionOptions defaultCompressionOptions;
+
+#ifdef CEX_WITH_ZLIB
+//***************************************************************************
+// deflate stream pool
+//***************************************************************************
+// deflateInit2 allocates ~256 KB of state (default memLevel/windowBits), so
+// initialized streams are kept per thread and reused with deflateReset
+
+struct DeflateStream
+{
    z_stream strm;
+   CompressionMode mode;
+   int level;
+   int memLevel;
+   int windowBits;
+};
 
-   strm.zalloc = Z_NULL;
-   strm.zfree = Z_NULL;
-   strm.opaque = Z_NULL;
+struct DeflatePool
+{
+   ~DeflatePool()
+   {
+      for (size_t i= 0; i < streams.size(); i++)
+      {
+         deflateEnd(&streams[i]->strm);
+         delete streams[i];
+      }
+   }
 
-   if (compMode == cmGZip)
+   std::vector<DeflateStream*> streams;     // idle streams
+};
+
+static thread_local DeflatePool deflatePool;
+
+static DeflateStream* acquireStream(CompressionMode compMode, const CompressionOptions* opts)
+{
+   for (size_t i= deflatePool.streams.size(); i > 0; i--)
    {
-      int windowBits = 15;
-      int GZIP_ENCODING = 16;
+      DeflateStream* stream= deflatePool.streams[i-1];
 
-      res = deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits | GZIP_ENCODING, 8, Z_DEFAULT_STRATEGY);
+      if (stream->mode == compMode && stream->level == opts->level && stream->memLevel == opts->memLevel && stream->windowBits == opts->windowBits)
+      {
+         deflatePool.streams[i-1]= deflatePool.streams.back();
+         deflatePool.streams.pop_back();
+
+         return stream;
+      }
    }
-   else
-      res = deflateInit(&strm, Z_DEFAULT_COMPRESSION);
 
-   if (res != Z_OK)
-      return res;
+   DeflateStream* stream= new DeflateStream();
 
-   // compress until end of input
+   stream->strm.zalloc= Z_NULL;
+   stream->strm.zfree= Z_NULL;
+   stream->strm.opaque= Z_NULL;
+   stream->mode= compMode;
+   stream->level= opts->level;
+   stream->memLevel= opts->memLevel;
+   stream->windowBits= opts->windowBits;
 
-   do 
+   // windowBits + 16: gzip header/trailer instead of zlib's
+
+   int windowBits= compMode == cmGZip ? opts->windowBits | 16 : opts->windowBits;
+
+   if (deflateInit2(&stream->strm, opts->level, Z_DEFLATED, windowBits, opts->memLevel, Z_DEFAULT_STRATEGY) != Z_OK)
    {
-      size_t nextChunkLen = srcLen-bytesRead < IO_BUFFER_SIZE ? srcLen-bytesRead : IO_BUFFER_SIZE;
+      delete stream;
+      return nullptr;
+   }
 
-      flush = nextChunkLen < IO_BUFFER_SIZE ? Z_FINISH : Z_NO_FLUSH;
-      strm.avail_in = nextChunkLen;
-      strm.next_in = (Bytef*)(src+bytesRead);
+   return stream;
+}
 
-      bytesRead += nextChunkLen;
+static void releaseStream(DeflateStream* stream)
+{
+   if (deflatePool.streams.size() >= CEX_DEFLATE_POOL_SIZE || deflateReset(&stream->strm) != Z_OK)
+   {
+      deflateEnd(&stream->strm);
+      delete stream;
+      return;
+   }
 
-      // run deflate() on input until output buffer not full, finish
-      // compression if all of src has been read in
+   deflatePool.streams.push_back(stream);
+}
+#endif // CEX_WITH_ZLIB
 
-      do 
-      {
-         size_t bytesCompressed= 0;
-         strm.avail_out = IO_BUFFER_SIZE;
-         strm.next_out = (Bytef*)out;
+#ifdef CEX_WITH_ZSTD
+//***************************************************************************
+// zstd context pool
+//***************************************************************************
+// same as for deflate: contexts keep their (level dependent) work buffers,
+// so they are reused per thread. the level is set on each acquire
+
+struct ZstdPool
+{
+   ~ZstdPool()
+   {
+      for (size_t i= 0; i < contexts.size(); i++)
+         ZSTD_freeCCtx(contexts[i]);
+   }
 
-         res = deflate(&strm, flush);
+   std::vector<ZSTD_CCtx*> contexts;        // idle contexts
+};
 
-         if (res == Z_STREAM_ERROR)
-            return res;
+static thread_local ZstdPool zstdPool;
 
-         bytesCompressed= IO_BUFFER_SIZE - strm.avail_out;
+static ZSTD_CCtx* acquireZstd(const CompressionOptions* opts)
+{
+   ZSTD_CCtx* ctx= nullptr;
 
-         evbuffer_add(dest, out, bytesCompressed);
-      } 
-      while (strm.avail_out == 0);
-   } 
-   while (flush != Z_FINISH);
+   if (!zstdPool.contexts.empty())
+   {
+      ctx= zstdPool.contexts.back();
+      zstdPool.contexts.pop_back();
+   }
+   else if (!(ctx= ZSTD_createCCtx()))
+   {
+      return nullptr;
+   }
+
+   if (ZSTD_isError(ZSTD_CCtx_setParameter(ctx, ZSTD_c_compressionLevel, opts->zstdLevel)))
+   {
+      ZSTD_freeCCtx(ctx);
+      return nullptr;
+   }
 
-   deflateEnd(&strm);
+   return ctx;
+}
 
-   return done;
+static void releaseZstd(ZSTD_CCtx* ctx)
+{
+   if (zstdPool.contexts.size() >= CEX_DEFLATE_POOL_SIZE || ZSTD_isError(ZSTD_CCtx_reset(ctx, ZSTD_reset_session_and_parameters)))
+   {
+      ZSTD_freeCCtx(ctx);
+      return;
+   }
+
+   zstdPool.contexts.push_back(ctx);
 }
+#endif // CEX_WITH_ZSTD
 
 //***************************************************************************
-// compress stream (GZIP or deflate)
+// class Compressor
+//***************************************************************************
+// ctor/dtor
 //***************************************************************************
 
-int compress(std::istream* stream, std::function<void(char*,size_t)> onChunk, CompressionMode compMode)
+Compressor::Compressor(CompressionMode compMode, const CompressionOptions* opts)
+   : mode(compMode), state(nullptr), failed(false)
 {
-   if (!stream || !onChunk || !stream->good() || stream->eof())
-      return fail;
+   if (!opts)
+      opts= &defaultCompressionOptions;
 
-   int res, flush;
-   size_t bytesRead= 0;
-   char in[IO_BUFFER_SIZE];
-   char out[IO_BUFFER_SIZE];
+   switch (mode)
+   {
+#ifdef CEX_WITH_ZLIB
+      case cmDeflate:
+      case cmGZip:
+         state= acquireStream(mode, opts);
+         break;
+#endif
+#ifdef CEX_WITH_ZSTD
+      case cmZstd:
+         state= acquireZstd(opts);
+         break;
+#endif
+#ifdef CEX_WITH_BROTLI
+      case cmBrotli:
+      {
+         // brotli encoders can't be reset, so there is no pool
 
-   int windowBits = 15;
-   int GZIP_ENCODING = 16;
-   z_stream strm;
+         BrotliEncoderState* encoder= BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
 
-   strm.zalloc = Z_NULL;
-   strm.zfree = Z_NULL;
-   strm.opaque = Z_NULL;
+         if (encoder && !BrotliEncoderSetParameter(encoder, BROTLI_PARAM_QUALITY, opts->brotliQuality))
+         {
+            BrotliEncoderDestroyInstance(encoder);
+            encoder= nullptr;
+         }
 
-   if (compMode == cmGZip)
-      res = deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits | GZIP_ENCODING, 8, Z_DEFAULT_STRATEGY);
-   else
-      res = deflateInit(&strm, Z_DEFAULT_COMPRESSION);
+         state= encoder;
+         break;
+      }
+#endif
+      default:
+         break;
+   }
+}
 
-   if (res != Z_OK)
-      return res;
+Compressor::~Compressor()
+{
+   if (!state)
+      return;
 
-   // compress until end of input
+   switch (mode)
+   {
+#ifdef CEX_WITH_ZLIB
+      case cmDeflate:
+      case cmGZip:
+      {
+         DeflateStream* stream= (DeflateStream*)state;
+
+         if (failed)
+         {
+            deflateEnd(&stream->strm);
+            delete stream;
+         }
+         else
+         {
+            releaseStream(stream);
+         }
+
+         break;
+      }
+#endif
+#ifdef CEX_WITH_ZSTD
+      case cmZstd:
+         if (failed)
+            ZSTD_freeCCtx((ZSTD_CCtx*)state);
+         else
+            releaseZstd((ZSTD_CCtx*)state);
+         break;
+#endif
+#ifdef CEX_WITH_BROTLI
+      case cmBrotli:
+         BrotliEncoderDestroyInstance((BrotliEncoderState*)state);
+         break;
+#endif
+      default:
+         break;
+   }
+}
 
-   do 
+//***************************************************************************
+// write
+//***************************************************************************
+
+int Compressor::write(const char* data, size_t len, bool finish, const std::function<void(char*,size_t)>& onChunk)
+{
+   char out[IO_BUFFER_SIZE];
+
+   if (!state || failed)
+      return fail;
+
+   failed= true;
+
+   switch (mode)
    {
-      stream->read(in, IO_BUFFER_SIZE);
-      size_t nextChunkLen = stream->gcount();
+#ifdef CEX_WITH_ZLIB
+      case cmDeflate:
+      case cmGZip:
+      {
+         z_stream& strm= ((DeflateStream*)state)->strm;
+         int flush= finish ? Z_FINISH : Z_NO_FLUSH;
+
+         strm.avail_in= len;
+         strm.next_in= (Bytef*)data;
 
-      flush = nextChunkLen < IO_BUFFER_SIZE ? Z_FINISH : Z_NO_FLUSH;
-      strm.avail_in = nextChunkLen;
-      strm.next_in = (Bytef*)in;
+         // run deflate() until the output buffer is not full anymore. with Z_FINISH,
+         // this means the stream has ended
 
-      bytesRead += nextChunkLen;
+         do
+         {
+            strm.avail_out= IO_BUFFER_SIZE;
+            strm.next_out= (Bytef*)out;
 
-      // run deflate() on input until output buffer not full, finish
-      // compression if all of src has been read in
+            if (deflate(&strm, flush) == Z_STREAM_ERROR)
+               return fail;
 
-      do 
+            if (strm.avail_out < IO_BUFFER_SIZE)
+               onChunk(out, IO_BUFFER_SIZE - strm.avail_out);
+         }
+         while (strm.avail_out == 0);
+
+         break;
+      }
+#endif
+#ifdef CEX_WITH_ZSTD
+      case cmZstd:
       {
-         size_t bytesCompressed= 0;
-         strm.avail_out = IO_BUFFER_SIZE;
-         strm.next_out = (Bytef*)out;
+         ZSTD_inBuffer in= { data, len, 0 };
 
-         res = deflate(&strm, flush);
+         while (true)
+         {
+            ZSTD_outBuffer output= { out, IO_BUFFER_SIZE, 0 };
+            size_t remaining= ZSTD_compressStream2((ZSTD_CCtx*)state, &output, &in, finish ? ZSTD_e_end : ZSTD_e_continue);
 
-         if (res == Z_STREAM_ERROR)
-            return res;
+            if (ZSTD_isError(remaining))
+               return fail;
 
-         bytesCompressed= IO_BUFFER_SIZE - strm.avail_out;
-         onChunk(out, bytesCompressed);
-      } 
-      while (strm.avail_out == 0);
-   } 
-   while (flush != Z_FINISH);
+            if (output.pos)
+               onChunk(out, output.pos);
+
+            if (finish ? !remaining : in.pos == in.size)
+               break;
+         }
+
+         break;
+      }
+#endif
+#ifdef CEX_WITH_BROTLI
+      case cmBrotli:
+      {
+         BrotliEncoderState* encoder= (BrotliEncoderState*)state;
+         const uint8_t* nextIn= (const uint8_t*)data;
+         size_t availIn= len;
+
+         while (true)
+         {
+            uint8_t* nextOut= (uint8_t*)out;
+            size_t availOut= IO_BUFFER_SIZE;
+
+            if (!BrotliEncoderCompressStream(encoder, finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS, &availIn, &nextIn, &availOut, &nextOut, nullptr))
+               return fail;
 
-   deflateEnd(&strm);
+            if (availOut < IO_BUFFER_SIZE)
+               onChunk(out, IO_BUFFER_SIZE - availOut);
+
+            if (finish ? BrotliEncoderIsFinished(encoder) : (!availIn && !BrotliEncoderHasMoreOutput(encoder)))
+               break;
+         }
+
+         break;
+      }
+#endif
+      default:
+         return fail;
+   }
+
+   failed= false;
 
    return done;
 }
 
-#endif // CEX_WITH_ZLIB
+//***************************************************************************
+// compress buffer
+//***************************************************************************
+
+int compress(const char* src, size_t srcLen, struct evbuffer* dest, CompressionMode compMode, const CompressionOptions* opts)
+{
+   if (!src || !dest)
+      return fail;
+
+   Compressor compressor(compMode, opts);
+
+   // the whole input is available, so it is compressed in one pass
+
+   return compressor.write(src, srcLen, true, [dest](char* data, size_t len)
+   {
+      evbuffer_add(dest, data, len);
+   });
+}
+
+//***************************************************************************
+// compress stream
+//***************************************************************************
+
+int compress(std::istream* stream, std::function<void(char*,size_t)> onChunk, CompressionMode compMode, const CompressionOptions* opts)
+{
+   if (!stream || !onChunk || !stream->good() || stream->eof())
+      return fail;
+
+   Compressor compressor(compMode, opts);
+   char in[IO_BUFFER_SIZE];
+   bool finish= false;
+
+   // compress until end of input
+
+   do 
+   {
+      stream->read(in, IO_BUFFER_SIZE);
+      size_t nextChunkLen= stream->gcount();
+
+      finish= nextChunkLen < IO_BUFFER_SIZE;
+
+      if (compressor.write(in, nextChunkLen, finish, onChunk) != done)
+         return fail;
+   } 
+   while (!finish);
+
+   return done;
+}
+
+#endif // CEX_WITH_COMPRESSION
 
 //***************************************************************************
 } // namespace cex
@@ -0,0 +1,159 @@
+//*************************************************************************
+// File compression.cc
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// cex Library response compression testcases
+//*************************************************************************
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#ifdef CEX_WITH_ZLIB
+#  define CPPHTTPLIB_ZLIB_SUPPORT
+#endif
+
+#ifdef CEX_WITH_ZSTD
+#  include <zstd.h>
+#endif
+
+#include <bandit/bandit.h>
+#include <httplib.h>
+#include <cex.hpp>
+
+using namespace snowhouse;
+using namespace bandit;
+
+//***************************************************************************
+// testcase definitions
+//***************************************************************************
+
+go_bandit([]() 
+{
+   //************************************************************************
+   // compression negotiation testcases
+   //************************************************************************
+
+   describe("Compression negotiation", []() 
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+      std::string text(2000, 'a');
+
+      cex::Server::Config config;
+      config.compressMinBytes= 1000;
+
+      cex::Server app(config);
+      httplib::Client cli(host, port);
+
+      app.get("/text", [&text](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         res->set("Content-Type", "text/plain");
+         res->end(text.c_str(), text.size(), 200);
+      });
+
+      app.get("/small", [](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         res->set("Content-Type", "text/plain");
+         res->end("small", 200);
+      });
+
+      app.get("/image", [&text](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         res->set("Content-Type", "image/jpeg");
+         res->end(text.c_str(), text.size(), 200);
+      });
+
+      app.listen(host, port, 0 /* don't block */);
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should always send Vary: Accept-Encoding", [&]() 
+      {
+         auto res = cli.Get("/small");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->get_header_value("Vary"), Equals(std::string("Accept-Encoding")));
+      });
+
+#ifdef CEX_WITH_ZLIB
+      it("should compress if the client accepts gzip", [&]() 
+      {
+         auto res = cli.Get("/text", { { "Accept-Encoding", "deflate;q=0.5, gzip" } });
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->get_header_value("Content-Encoding"), Equals(std::string("gzip")));
+         AssertThat(res->body, Equals(text));
+      });
+
+      it("should not compress encodings with q=0", [&]() 
+      {
+         auto res = cli.Get("/text", { { "Accept-Encoding", "gzip;q=0, identity" } });
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->has_header("Content-Encoding"), Equals(false));
+         AssertThat(res->body, Equals(text));
+
+         res = cli.Get("/text", { { "Accept-Encoding", "*;q=0" } });
+
+         AssertThat(res->has_header("Content-Encoding"), Equals(false));
+      });
+
+      it("should not compress bodies below compressMinBytes", [&]() 
+      {
+         auto res = cli.Get("/small", { { "Accept-Encoding", "gzip" } });
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->has_header("Content-Encoding"), Equals(false));
+      });
+
+      it("should not compress binary content types", [&]() 
+      {
+         auto res = cli.Get("/image", { { "Accept-Encoding", "gzip" } });
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->has_header("Content-Encoding"), Equals(false));
+         AssertThat(res->body, Equals(text));
+      });
+#endif
+
+#ifdef CEX_WITH_ZSTD
+      it("should compress with zstd if the client prefers it", [&]() 
+      {
+         auto res = cli.Get("/text", { { "Accept-Encoding", "gzip;q=0.8, zstd" } });
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->get_header_value("Content-Encoding"), Equals(std::string("zstd")));
+
+         std::string body(text.size(), 0);
+         size_t len= ZSTD_decompress(&body[0], body.size(), res->body.data(), res->body.size());
+
+         AssertThat(ZSTD_isError(len), Equals(0u));
+         AssertThat(body.substr(0, len), Equals(text));
+      });
+#endif
+
+#ifdef CEX_WITH_BROTLI
+      it("should compress with brotli if the client prefers it", [&]() 
+      {
+         auto res = cli.Get("/text", { { "Accept-Encoding", "gzip;q=0.5, br" } });
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->get_header_value("Content-Encoding"), Equals(std::string("br")));
+         AssertThat(res->body.size() < text.size(), Equals(true));
+      });
+#endif
+   });
+});
+
+//***************************************************************************
+// main
+//***************************************************************************
+
+int main(int argc, char* argv[]) 
+{
+   return bandit::run(argc, argv);
+}
@@ -0,0 +1,142 @@
+//*************************************************************************
+// File coroutines.cc
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// cex Library coroutine middlewares testcases (C++20 only)
+//*************************************************************************
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <bandit/bandit.h>
+#include <httplib.h>
+#include <cex.hpp>
+
+#if defined(__cpp_impl_coroutine)
+#  include <cex/coroutine.hpp>
+#endif
+
+using namespace snowhouse;
+using namespace bandit;
+
+//***************************************************************************
+// testcase definitions
+//***************************************************************************
+
+go_bandit([]()
+{
+#if defined(__cpp_impl_coroutine)
+   //************************************************************************
+   // coroutine middlewares testcases
+   //************************************************************************
+
+   describe("Coroutine middlewares", []()
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+      std::mutex mutex;
+      std::string order;
+
+      cex::Server app;
+      httplib::Client cli(host, port);
+
+      app.get("/sleep", [](cex::Request* req, cex::Response* res, cex::Next next) -> cex::Task
+      {
+         std::chrono::steady_clock::time_point begin= std::chrono::steady_clock::now();
+
+         co_await cex::sleepFor(std::chrono::milliseconds(50));
+
+         long elapsed= std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+         std::string body= std::to_string(elapsed);
+
+         res->end(body.c_str(), body.size(), 200);
+      });
+
+      app.get("/completion", [](cex::Request* req, cex::Response* res, cex::Next next) -> cex::Task
+      {
+         cex::Completion<std::string> result(res);
+
+         std::thread([result]()
+         {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            result.set("from another thread");
+         }).detach();
+
+         std::string value= co_await result;
+
+         res->end(value.c_str(), value.size(), 200);
+      });
+
+      app.get("/next", [&mutex, &order](cex::Request* req, cex::Response* res, cex::Next next) -> cex::Task
+      {
+         { std::lock_guard<std::mutex> lock(mutex); order+= "a"; }
+
+         co_await next;
+
+         { std::lock_guard<std::mutex> lock(mutex); order+= "c"; }
+      });
+
+      app.get("/next", [&mutex, &order](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         { std::lock_guard<std::mutex> lock(mutex); order+= "b"; }
+
+         res->end("next", 4, 200);
+      });
+
+      app.listen(host, port, 0 /* don't block */);
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should resume after sleepFor", [&]()
+      {
+         auto res = cli.Get("/sleep");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(atoi(res->body.c_str()) >= 50, Equals(true));
+      });
+
+      it("should resume with the value of a completion", [&]()
+      {
+         auto res = cli.Get("/completion");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body, Equals(std::string("from another thread")));
+      });
+
+      it("should resume after the following middlewares", [&]()
+      {
+         auto res = cli.Get("/next");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body, Equals(std::string("next")));
+
+         for (int i= 0; i < 100; i++)
+         {
+            { std::lock_guard<std::mutex> lock(mutex); if (order.size() == 3) break; }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+         }
+
+         std::lock_guard<std::mutex> lock(mutex);
+         AssertThat(order, Equals(std::string("abc")));
+      });
+   });
+#endif
+});
+
+//***************************************************************************
+// main
+//***************************************************************************
+
+int main(int argc, char* argv[])
+{
+   return bandit::run(argc, argv);
+}
@@ -0,0 +1,105 @@
+//*************************************************************************
+// File deferred.cc
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// cex Library deferred responses testcases
+//*************************************************************************
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <bandit/bandit.h>
+#include <httplib.h>
+#include <cex.hpp>
+
+using namespace snowhouse;
+using namespace bandit;
+
+//***************************************************************************
+// testcase definitions
+//***************************************************************************
+
+go_bandit([]()
+{
+   //************************************************************************
+   // deferred responses testcases
+   //************************************************************************
+
+   describe("Deferred responses", []()
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+      std::atomic<int> secondEnd(0);
+
+      cex::Server app;
+      httplib::Client cli(host, port);
+
+      app.get("/later", [](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         cex::DeferredPtr deferred= res->defer();
+
+         std::thread([deferred]()
+         {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            deferred->end("later", 200);
+         }).detach();
+      });
+
+      app.get("/run", [&secondEnd](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         cex::DeferredPtr deferred= res->defer();
+
+         std::thread([deferred, &secondEnd]()
+         {
+            deferred->run([](cex::Response* res) { res->set("X-Deferred", "yes"); });
+            deferred->end(201);
+
+            // completed already
+
+            secondEnd= deferred->end(500);
+         }).detach();
+      });
+
+      app.listen(host, port, 0 /* don't block */);
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should send a response completed from another thread", [&]()
+      {
+         auto res = cli.Get("/later");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body, Equals(std::string("later", 6)));
+      });
+
+      it("should run queued functions in order on the worker thread", [&]()
+      {
+         auto res = cli.Get("/run");
+
+         AssertThat(res->status, Equals(201));
+         AssertThat(res->get_header_value("X-Deferred"), Equals(std::string("yes")));
+
+         for (int i= 0; i < 100 && !secondEnd; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+         AssertThat((int)secondEnd, Equals((int)cex::fail));
+      });
+   });
+});
+
+//***************************************************************************
+// main
+//***************************************************************************
+
+int main(int argc, char* argv[])
+{
+   return bandit::run(argc, argv);
+}
@@ -19,6 +19,13 @@
 #include <cex.hpp>
 #include <cex/filesystem.hpp>
 
+#include <chrono>
+#include <thread>
+
+#include <dirent.h>
+#include <stdio.h>
+#include <unistd.h>
+
 #ifdef CEX_WITH_SSL
 #  include <openssl/md5.h>
 #endif
@@ -28,6 +35,7 @@ using namespace bandit;
 
 void AssertMD5(std::string& body, const char* aMD5);
 void getMD5Sum(const unsigned char* data, size_t len, char* target);
+int countOpenFiles();
 
 //***************************************************************************
 // testcase definitions
@@ -45,7 +53,10 @@ go_bandit([]()
       const char* host= "127.0.0.1";
       const char* payload= "<h1>It works!</h1>\n";
 
-      cex::Server app;
+      cex::Server::Config config;
+      config.compressMinBytes= 0;
+
+      cex::Server app(config);
       httplib::Client cli(host, port);
 
       std::shared_ptr<cex::FilesystemOptions> fsOpts(new cex::FilesystemOptions());
@@ -107,6 +118,154 @@ go_bandit([]()
       });
 #endif
 
+      it("should send uncompressed files with Content-Length instead of chunks", [&]() 
+      {
+         auto res = cli.Get("/content/testdata2.bin");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.size(), Equals(1048576));
+         AssertThat(res->get_header_value("Content-Length"), Equals(std::string("1048576")));
+         AssertThat(res->has_header("Transfer-Encoding"), Equals(false));
+      });
+
+      it("should close the file after sending it", [&]() 
+      {
+         // requests are finished (and the file closed) just after the client got the response
+
+         cli.Get("/content/testdata1.txt");
+         std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+         int before= countOpenFiles();
+
+         for (int i= 0; i < 50; i++)
+            AssertThat(cli.Get("/content/testdata1.txt")->status, Equals(200));
+
+         std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+         AssertThat(countOpenFiles() <= before + 2, Equals(true));
+      });
+
+      it("should answer a single range with 206 (Range: bytes=0-3)", [&]() 
+      {
+         auto res = cli.Get("/content/testdata1.txt", { { "Range", "bytes=0-3" } });
+
+         AssertThat(res->status, Equals(206));
+         AssertThat(res->body, Equals(std::string("<h1>")));
+         AssertThat(res->get_header_value("Content-Range"), Equals(std::string("bytes 0-3/19")));
+         AssertThat(res->get_header_value("Content-Type"), Equals(std::string("text/plain; charset=utf-8")));
+      });
+
+      it("should answer a suffix range with 206 (Range: bytes=-4)", [&]() 
+      {
+         auto res = cli.Get("/content/testdata1.txt", { { "Range", "bytes=-4" } });
+
+         AssertThat(res->status, Equals(206));
+         AssertThat(res->body, Equals(std::string("h1>\n")));
+         AssertThat(res->get_header_value("Content-Range"), Equals(std::string("bytes 15-18/19")));
+      });
+
+      it("should answer multiple ranges with multipart/byteranges", [&]() 
+      {
+         auto res = cli.Get("/content/testdata2.bin", { { "Range", "bytes=0-9, 1000-1099, -10" } });
+
+         AssertThat(res->status, Equals(206));
+         AssertThat(res->get_header_value("Content-Type").find("multipart/byteranges; boundary="), Equals(0));
+         AssertThat(res->body.find("Content-Range: bytes 0-9/1048576"), Is().Not().EqualTo(std::string::npos));
+         AssertThat(res->body.find("Content-Range: bytes 1000-1099/1048576"), Is().Not().EqualTo(std::string::npos));
+         AssertThat(res->body.find("Content-Range: bytes 1048566-1048575/1048576"), Is().Not().EqualTo(std::string::npos));
+         AssertThat(res->body.size(), Is().GreaterThan(120));
+      });
+
+      it("should close the file after sending multiple ranges", [&]() 
+      {
+         cli.Get("/content/testdata2.bin", { { "Range", "bytes=0-9, -10" } });
+         std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+         int before= countOpenFiles();
+
+         for (int i= 0; i < 50; i++)
+            AssertThat(cli.Get("/content/testdata2.bin", { { "Range", "bytes=0-9, -10" } })->status, Equals(206));
+
+         std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+         AssertThat(countOpenFiles() <= before + 2, Equals(true));
+      });
+
+      it("should answer unsatisfiable ranges with 416", [&]() 
+      {
+         auto res = cli.Get("/content/testdata1.txt", { { "Range", "bytes=100-" } });
+
+         AssertThat(res->status, Equals(416));
+         AssertThat(res->get_header_value("Content-Range"), Equals(std::string("bytes */19")));
+      });
+
+      it("should send the whole file for invalid ranges or an outdated If-Range", [&]() 
+      {
+         auto res = cli.Get("/content/testdata1.txt", { { "Range", "items=0-3" } });
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals(payload));
+
+         res = cli.Get("/content/testdata1.txt", { { "Range", "bytes=0-3" }, { "If-Range", "Mon, 01 Jan 2001 00:00:00 GMT" } });
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals(payload));
+      });
+
+      it("should send ETag and Last-Modified validators", [&]() 
+      {
+         auto res = cli.Get("/content/testdata1.txt");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->has_header("ETag"), Equals(true));
+         AssertThat(res->has_header("Last-Modified"), Equals(true));
+      });
+
+      it("should answer conditional requests for unmodified files with 304", [&]() 
+      {
+         auto res = cli.Get("/content/testdata1.txt");
+         std::string etag= res->get_header_value("ETag");
+         std::string lastModified= res->get_header_value("Last-Modified");
+
+         res = cli.Get("/content/testdata1.txt", { { "If-None-Match", etag } });
+
+         AssertThat(res->status, Equals(304));
+         AssertThat(res->body.size(), Equals(0));
+         AssertThat(res->get_header_value("ETag"), Equals(etag));
+
+         res = cli.Get("/content/testdata1.txt", { { "If-Modified-Since", lastModified } });
+
+         AssertThat(res->status, Equals(304));
+
+         res = cli.Get("/content/testdata1.txt", { { "If-None-Match", "\"outdated\"" } });
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals(payload));
+
+         res = cli.Get("/content/testdata1.txt", { { "If-Modified-Since", "Mon, 01 Jan 2001 00:00:00 GMT" } });
+
+         AssertThat(res->status, Equals(200));
+      });
+
+      it("should honor If-Range with a matching ETag", [&]() 
+      {
+         auto res = cli.Get("/content/testdata1.txt");
+         std::string etag= res->get_header_value("ETag");
+
+         res = cli.Get("/content/testdata1.txt", { { "Range", "bytes=0-3" }, { "If-Range", etag } });
+
+         AssertThat(res->status, Equals(206));
+         AssertThat(res->body, Equals(std::string("<h1>")));
+      });
+
+      it("should answer directories with 404 (/content/)", [&]() 
+      {
+         auto res = cli.Get("/content/");
+
+         AssertThat(res->status, Equals(404));
+         AssertThat(res->body.size(), Equals(0));
+      });
+
       it("should answer non existing filepaths with 404 (/content/does/not/exist)", [&]() 
       {
          auto res = cli.Get("/content/does/not/exist");
@@ -137,14 +296,13 @@ go_bandit([]()
          AssertThat(res->get_header_value("Content-Type"), Equals(std::string("text/plain; charset=utf-8")));
       });
 
-      it("should GZIP compress binary contents of /gzipContent/testdata2.bin", [&]() 
+      it("should not compress binary contents of /gzipContent/testdata2.bin", [&]() 
       {
          auto res = cli.Get("/gzipContent/testdata2.bin");
 
          AssertThat(res->status, Equals(200));
-         AssertMD5(res->body, "24b73bf87c2f7cda464b9750c86364b8");
-         AssertThat(res->has_header("Content-Encoding"), Equals(true));
-         AssertThat(res->get_header_value("Content-Encoding"), Equals(std::string("gzip")));
+         AssertThat(res->body.size(), Equals(1048576));
+         AssertThat(res->has_header("Content-Encoding"), Equals(false));
          AssertThat(res->get_header_value("Content-Type"), Equals(std::string("application/octet-stream")));
       });
 #endif
@@ -160,6 +318,191 @@ go_bandit([]()
 //         AssertThat(res->get_header_value("Content-Encoding"), Equals(std::string("gzip")));
 //      });
    });
+
+   //************************************************************************
+   // filesystem cache testcases
+   //************************************************************************
+
+   describe("Filesystem cache testcases", []() 
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+
+      cex::Server::Config config;
+      config.compressMinBytes= 0;
+
+      cex::Server app(config);
+      httplib::Client cli(host, port);
+
+      std::shared_ptr<cex::FilesystemOptions> fsOpts(new cex::FilesystemOptions());
+
+      fsOpts.get()->rootPath= "testdata/filesystem";
+      fsOpts.get()->cache= true;
+      fsOpts.get()->cacheMaxFileSize= 1000;
+      fsOpts.get()->cacheRevalidate= 0;
+      fsOpts.get()->etagHash= true;
+      fsOpts.get()->etagHashMaxFileSize= 1000;
+
+      app.use("/gzipContent", [](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         res->setFlags(res->getFlags() | cex::Response::fCompressGZip);
+         next();
+      });
+
+      app.use("/content", cex::filesystem(fsOpts));
+      app.use("/gzipContent", cex::filesystem(fsOpts));
+
+      app.listen(host, port, 0 /* don't block */);
+
+      auto writeFile= [](const char* path, const char* contents)
+      {
+         // replace the file (new inode)
+
+         std::string tmp= std::string(path) + ".tmp";
+         FILE* f= fopen(tmp.c_str(), "w");
+
+         fputs(contents, f);
+         fclose(f);
+         rename(tmp.c_str(), path);
+      };
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should serve cached contents repeatedly", [&]() 
+      {
+         for (int i= 0; i < 3; i++)
+         {
+            auto res = cli.Get("/content/testdata1.txt");
+
+            AssertThat(res->status, Equals(200));
+            AssertThat(res->body.c_str(), Equals("<h1>It works!</h1>\n"));
+            AssertThat(res->get_header_value("Content-Length"), Equals(std::string("19")));
+         }
+      });
+
+      it("should reload modified files", [&]() 
+      {
+         writeFile("testdata/filesystem/cached.txt", "first version");
+
+         auto res = cli.Get("/content/cached.txt");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals("first version"));
+
+         writeFile("testdata/filesystem/cached.txt", "second, longer version");
+
+         res = cli.Get("/content/cached.txt");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals("second, longer version"));
+
+         unlink("testdata/filesystem/cached.txt");
+
+         res = cli.Get("/content/cached.txt");
+
+         AssertThat(res->status, Equals(404));
+      });
+
+      it("should reload files rewritten in place", [&]() 
+      {
+         FILE* f= fopen("testdata/filesystem/inplace.txt", "w");
+         fputs("first version", f);
+         fclose(f);
+
+         auto res = cli.Get("/content/inplace.txt");
+
+         AssertThat(res->body.c_str(), Equals("first version"));
+
+         // same inode, truncated and written again
+
+         f= fopen("testdata/filesystem/inplace.txt", "w");
+         fputs("second", f);
+         fclose(f);
+
+         res = cli.Get("/content/inplace.txt");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals("second"));
+         AssertThat(res->get_header_value("Content-Length"), Equals(std::string("6")));
+
+         unlink("testdata/filesystem/inplace.txt");
+      });
+
+#ifdef CEX_WITH_ZLIB
+      it("should serve the cached compressed representation repeatedly", [&]() 
+      {
+         for (int i= 0; i < 3; i++)
+         {
+            auto res = cli.Get("/gzipContent/testdata1.txt");
+
+            AssertThat(res->status, Equals(200));
+            AssertThat(res->body.c_str(), Equals("<h1>It works!</h1>\n"));
+            AssertThat(res->get_header_value("Content-Encoding"), Equals(std::string("gzip")));
+         }
+      });
+
+      it("should serve precompressed sibling files (.gz)", [&]() 
+      {
+         writeFile("testdata/filesystem/sibling.txt", "plain contents");
+
+         gzFile gz= gzopen("testdata/filesystem/sibling.txt.gz", "wb");
+         gzputs(gz, "precompressed contents");
+         gzclose(gz);
+
+         auto res = cli.Get("/gzipContent/sibling.txt");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals("precompressed contents"));
+         AssertThat(res->get_header_value("Content-Encoding"), Equals(std::string("gzip")));
+         AssertThat(res->get_header_value("Content-Type"), Equals(std::string("text/plain; charset=utf-8")));
+
+         res = cli.Get("/content/sibling.txt");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals("plain contents"));
+
+         unlink("testdata/filesystem/sibling.txt");
+         unlink("testdata/filesystem/sibling.txt.gz");
+      });
+#endif
+
+      it("should use a content hash as ETag", [&]() 
+      {
+         writeFile("testdata/filesystem/hashed1.txt", "same contents");
+         writeFile("testdata/filesystem/hashed2.txt", "same contents");
+
+         auto res1 = cli.Get("/content/hashed1.txt");
+         auto res2 = cli.Get("/content/hashed2.txt");
+
+         AssertThat(res1->status, Equals(200));
+         AssertThat(res1->get_header_value("ETag"), Equals(res2->get_header_value("ETag")));
+
+         auto res = cli.Get("/content/hashed1.txt", { { "If-None-Match", res1->get_header_value("ETag") } });
+
+         AssertThat(res->status, Equals(304));
+
+         unlink("testdata/filesystem/hashed1.txt");
+         unlink("testdata/filesystem/hashed2.txt");
+      });
+
+      it("should not hash files exceeding etagHashMaxFileSize", [&]() 
+      {
+         auto res = cli.Get("/content/testdata2.bin", { { "Range", "bytes=0-9" } });
+
+         AssertThat(res->status, Equals(206));
+         AssertThat(res->get_header_value("ETag").find('-') != std::string::npos, Equals(true));
+      });
+
+      it("should serve files exceeding the cache limits from disk", [&]() 
+      {
+         auto res = cli.Get("/content/testdata2.bin");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.size(), Equals(1048576));
+      });
+   });
 });
 
 //***************************************************************************
@@ -192,6 +535,24 @@ void getMD5Sum(const unsigned char* data, size_t len, char* target)
 #endif
 }
 
+int countOpenFiles()
+{
+   // open file descriptors of this process (server and client), Linux only
+
+   DIR* dir= opendir("/proc/self/fd");
+   int count= 0;
+
+   if (!dir)
+      return 0;
+
+   while (readdir(dir))
+      count++;
+
+   closedir(dir);
+
+   return count;
+}
+
 //***************************************************************************
 // main
 //***************************************************************************
@@ -0,0 +1,238 @@
+//*************************************************************************
+// File metrics.cc
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// cex Library metrics testcases
+//*************************************************************************
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <chrono>
+#include <thread>
+
+#include <bandit/bandit.h>
+#include <httplib.h>
+#include <cex.hpp>
+#include <cex/metrics.hpp>
+
+using namespace snowhouse;
+using namespace bandit;
+
+//***************************************************************************
+// testcase definitions
+//***************************************************************************
+
+go_bandit([]()
+{
+   //************************************************************************
+   // histogram testcases
+   //************************************************************************
+
+   describe("Histogram", []()
+   {
+      it("should count small values exactly", [&]()
+      {
+         for (uint64_t value= 0; value < 16; value++)
+         {
+            AssertThat(cex::Histogram::lowerBound(cex::Histogram::bucketOf(value)), Equals(value));
+            AssertThat(cex::Histogram::upperBound(cex::Histogram::bucketOf(value)), Equals(value));
+         }
+      });
+
+      it("should keep values within their bucket's bounds", [&]()
+      {
+         for (uint64_t value= 16; value < 10000000; value= value * 3 / 2 + 1)
+         {
+            size_t bucket= cex::Histogram::bucketOf(value);
+
+            AssertThat(cex::Histogram::lowerBound(bucket) <= value, Equals(true));
+            AssertThat(cex::Histogram::upperBound(bucket) >= value, Equals(true));
+            AssertThat(cex::Histogram::upperBound(bucket) - cex::Histogram::lowerBound(bucket) <= value / 16, Equals(true));
+         }
+      });
+
+      it("should return percentiles", [&]()
+      {
+         cex::Histogram histogram;
+
+         for (uint64_t value= 1; value <= 1000; value++)
+            histogram.add(cex::Histogram::bucketOf(value), 1, value);
+
+         uint64_t p50= histogram.percentile(0.5);
+         uint64_t p99= histogram.percentile(0.99);
+
+         AssertThat(histogram.count(), Equals(1000u));
+         AssertThat(histogram.getSum(), Equals(500500u));
+         AssertThat(p50 >= 500 && p50 <= 500 + 500 / 16, Equals(true));
+         AssertThat(p99 >= 990 && p99 <= 990 + 990 / 16, Equals(true));
+         AssertThat(histogram.countUpTo(991), Equals(991u));     // bucket 976..991
+         AssertThat(histogram.countUpTo(1023), Equals(1000u));
+      });
+   });
+
+   //************************************************************************
+   // server metrics testcases
+   //************************************************************************
+
+   describe("Server metrics", []()
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+
+      cex::Server app;
+      httplib::Client cli(host, port);
+
+      app.get("/hello", [](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         res->end("hello", 200);
+      }, cex::Middleware::fMatchCompare);
+
+      app.get("/users/:id", [](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         res->end(404);
+      }, cex::Middleware::fMatchParams);
+
+      app.get("/metrics", cex::metricsHandler(&app), cex::Middleware::fMatchCompare);
+
+      app.get("/timed", [](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         std::this_thread::sleep_for(std::chrono::milliseconds(20));
+         next();
+      }, cex::Middleware::fMatchCompare);
+
+      app.get("/timed", [](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         res->end(200);
+      }, cex::Middleware::fMatchCompare);
+
+      app.use([](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         next();
+
+         if (!res->isDone())
+            res->end(404);
+      });
+
+      // not supported by the merged automaton, so it's a candidate of every GET request
+
+      app.get("^/archive/(?=2)", [](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         res->end(200);
+      }, cex::Middleware::fMatchRegex);
+
+      app.listen(host, port, 0 /* don't block */);
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should count requests, status codes and bytes", [&]()
+      {
+         cli.Get("/hello");
+         cli.Get("/hello");
+         cli.Get("/users/12");
+
+         // a request is counted when it is finished, which may be just after the client got the response
+
+         std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+         cex::MetricsSnapshot metrics= app.getMetrics();
+         uint64_t ok= 0, notFound= 0;
+
+         for (size_t i= 0; i < metrics.statusCodes.size(); i++)
+         {
+            if (metrics.statusCodes[i].first == 200)
+               ok= metrics.statusCodes[i].second;
+            else if (metrics.statusCodes[i].first == 404)
+               notFound= metrics.statusCodes[i].second;
+         }
+
+         AssertThat(metrics.requests, Equals(3u));
+         AssertThat(ok, Equals(2u));
+         AssertThat(notFound, Equals(1u));
+         AssertThat(metrics.bytesOut, Equals(2u * 6u));
+      });
+
+      it("should record the latency per middleware path", [&]()
+      {
+         cex::MetricsSnapshot metrics= app.getMetrics();
+         uint64_t hello= 0, users= 0;
+
+         for (size_t i= 0; i < metrics.routes.size(); i++)
+         {
+            if (metrics.routes[i].path == "/hello")
+               hello= metrics.routes[i].latency.count();
+            else if (metrics.routes[i].path == "/users/:id")
+               users= metrics.routes[i].latency.count();
+         }
+
+         AssertThat(hello, Equals(2u));
+         AssertThat(users, Equals(1u));
+      });
+
+      it("should export the metrics in the Prometheus text format", [&]()
+      {
+         auto res = cli.Get("/metrics");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->get_header_value("Content-Type"), Equals(std::string("text/plain; version=0.0.4")));
+         AssertThat(res->body, Contains("cex_requests_total 3\n"));
+         AssertThat(res->body, Contains("cex_responses_total{code=\"200\"} 2\n"));
+         AssertThat(res->body, Contains("cex_request_duration_seconds_count{route=\"/users/:id\"} 1\n"));
+         AssertThat(res->body, Contains("# TYPE cex_connections gauge\n"));
+      });
+
+#ifdef CEX_WITH_CHAIN_TIMING
+      it("should record the time spent in each middleware function", [&]()
+      {
+         cli.Get("/timed");
+
+         std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+         cex::MetricsSnapshot metrics= app.getMetrics();
+         const cex::MetricsSnapshot::MiddlewareTiming* slow= nullptr;
+         const cex::MetricsSnapshot::MiddlewareTiming* fast= nullptr;
+
+         for (size_t i= 0; i < metrics.middlewares.size(); i++)
+         {
+            if (metrics.middlewares[i].index == 3)
+               slow= &metrics.middlewares[i];
+            else if (metrics.middlewares[i].index == 4)
+               fast= &metrics.middlewares[i];
+         }
+
+         AssertThat(slow != nullptr && fast != nullptr, Equals(true));
+         AssertThat(slow->path, Equals(std::string("/timed")));
+         AssertThat(slow->duration.count(), Equals(1u));
+         AssertThat(slow->duration.getSum() >= 20000000u, Equals(true));
+         AssertThat(fast->duration.count(), Equals(1u));
+         AssertThat(fast->duration.getSum() < 20000000u, Equals(true));
+      });
+
+      it("should count candidates which did not match after the last called middleware", [&]()
+      {
+         uint64_t before= app.getMetrics().unmatched;
+
+         auto res = cli.Get("/archive/1");
+
+         AssertThat(res->status, Equals(404));
+
+         std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+         AssertThat(app.getMetrics().unmatched, Equals(before + 1));
+      });
+#endif
+   });
+});
+
+//***************************************************************************
+// main
+//***************************************************************************
+
+int main(int argc, char* argv[])
+{
+   return bandit::run(argc, argv);
+}
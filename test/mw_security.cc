@@ -14,6 +14,8 @@
 #include <httplib.h>
 #include <cex.hpp>
 #include <cex/security.hpp>
+#include <cex/basicauth.hpp>
+#include <cex/util.hpp>
 
 using namespace snowhouse;
 using namespace bandit;
@@ -103,6 +105,68 @@ go_bandit([]()
          AssertThat(res->has_header("X-XSS-Protection"), Equals(false));
       });
    });
+
+   //************************************************************************
+   // Basic authentication
+   //************************************************************************
+
+   describe("Basic authentication", []() 
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+
+      cex::Server app;
+      httplib::Client cli(host, port);
+
+      app.use(cex::basicAuth());
+      app.use([](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         std::string body= req->properties.getString("basicUsername") + "/" + req->properties.getString("basicPassword");
+         res->end(body.c_str(), 200);
+      });
+
+      app.listen(host, port, 0 /* don't block */);
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should decode base64 values of any length", [&]() 
+      {
+         const char* values[]= { "dXNlcjpwYXNz", "dXNlcjpwYQ==", "dXNlcjpwYQ", "dXNlcjpwYXM", "dXNlcjpwYXNzx" };
+         const char* expected[]= { "user:pass", "user:pa", "user:pa", "user:pas", "user:pass" };
+
+         for (size_t i= 0; i < sizeof(values) / sizeof(values[0]); i++)
+         {
+            // exactly sized, so reading past the end would be noticed by sanitizers/valgrind
+
+            std::vector<char> src(values[i], values[i] + strlen(values[i]));
+            std::vector<char> dest(cex::base64DecodedSize(src.size()));
+
+            size_t len= cex::base64Decode(src.data(), src.size(), dest.data());
+
+            AssertThat(std::string(dest.data(), len), Equals(std::string(expected[i])));
+         }
+      });
+
+      it("should parse the credentials of the Authorization header", [&]() 
+      {
+         httplib::Headers headers= { { "Authorization", "Basic dXNlcjpwYXNz" } };
+         auto res = cli.Get("/", headers);
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body, Equals("user/pass"));
+      });
+
+      it("should ignore an incomplete last character", [&]() 
+      {
+         httplib::Headers headers= { { "Authorization", "Basic dXNlcjpwYXNzx" } };
+         auto res = cli.Get("/", headers);
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body, Equals("user/pass"));
+      });
+   });
 });
 
 //***************************************************************************
@@ -58,6 +58,13 @@ go_bandit([]()
          res->end(200);
       });
 
+      app.use("/echosession", cex::sessionHandler(opts));
+      app.use("/echosession",  [](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         std::string sessionId= req->properties.getString("sessionID");
+         res->end(sessionId.c_str(), 200);
+      });
+
       app.use("/nosession",  [](cex::Request* req, cex::Response* res, std::function<void()> next)
       {
          res->end(200);
@@ -92,6 +99,16 @@ go_bandit([]()
          AssertThat(cv, Is().Containing("SameSite=Strict"));
       });
 
+      it("should take the session ID from the Cookie header for GET /echosession", [&]() 
+      {
+         httplib::Headers headers= { { "Cookie", "other=1; sessionID = abc123 ; last=2" } };
+         auto res = cli.Get("/echosession", headers);
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->has_header("Set-Cookie"), Equals(false));
+         AssertThat(res->body.c_str(), Equals("abc123"));
+      });
+
       it("should NOT set a Set-Cookie header for GET /nosession", [&]() 
       {
          auto res = cli.Get("/nosession");
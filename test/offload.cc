@@ -0,0 +1,170 @@
+//*************************************************************************
+// File offload.cc
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// cex Library offloaded middlewares testcases
+//*************************************************************************
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#include <chrono>
+#include <thread>
+
+#include <bandit/bandit.h>
+#include <httplib.h>
+#include <cex.hpp>
+#include <cex/filesystem.hpp>
+
+using namespace snowhouse;
+using namespace bandit;
+
+//***************************************************************************
+// testcase definitions
+//***************************************************************************
+
+go_bandit([]()
+{
+   //************************************************************************
+   // offloaded middlewares testcases
+   //************************************************************************
+
+   describe("Offloaded middlewares", []()
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+
+      // a single event loop, which must not be blocked by the slow middleware
+
+      cex::Server::Config config;
+      config.threadCount= 1;
+      config.offloadThreadCount= 2;
+
+      cex::Server app(config);
+      httplib::Client cli(host, port);
+
+      app.get("/slow", [](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+         res->set("X-Offloaded", "yes");
+         res->end("slow", 200);
+      }, cex::Middleware::fMatchCompare | cex::Middleware::fOffload);
+
+      app.get("/fast", [](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         res->end("fast", 200);
+      }, cex::Middleware::fMatchCompare);
+
+      app.get("/chain", [](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         res->set("X-First", "offloaded");
+         next();
+      }, cex::Middleware::fMatchCompare | cex::Middleware::fOffload);
+
+      app.get("/chain", [](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         res->end("chained", 200);
+      }, cex::Middleware::fMatchCompare);
+
+      // the wrapper's fallback must not touch the response while the offloaded middleware owns it
+
+      app.get("/wrapped", [](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         res->set("X-Wrapper", "before");
+         next();
+
+         if (!res->isDone())
+         {
+            res->set("X-Wrapper", "after");
+            res->end(404);
+         }
+      }, cex::Middleware::fMatchCompare);
+
+      app.get("/wrapped", [](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+         res->end("wrapped", 200);
+      }, cex::Middleware::fMatchCompare | cex::Middleware::fOffload);
+
+      std::shared_ptr<cex::FilesystemOptions> fsOpts(new cex::FilesystemOptions());
+      fsOpts.get()->rootPath= "testdata/filesystem";
+
+      app.use("/files", cex::filesystem(fsOpts), cex::Middleware::fMatchContain | cex::Middleware::fOffload);
+
+      app.listen(host, port, 0 /* don't block */);
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should send the response of an offloaded middleware", [&]()
+      {
+         auto res = cli.Get("/slow");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->get_header_value("X-Offloaded"), Equals(std::string("yes")));
+         AssertThat(res->body, Equals(std::string("slow", 5)));
+      });
+
+      it("should ignore responses of other middlewares while an offloaded middleware runs", [&]()
+      {
+         auto res = cli.Get("/wrapped");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body, Equals(std::string("wrapped", 8)));
+         AssertThat(res->get_header_value("X-Wrapper"), Equals(std::string("before")));
+      });
+
+      it("should not block other requests while an offloaded middleware runs", [&]()
+      {
+         std::thread slow([host, port]()
+         {
+            httplib::Client slowCli(host, port);
+            slowCli.Get("/slow");
+         });
+
+         std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+         std::chrono::steady_clock::time_point begin= std::chrono::steady_clock::now();
+         auto res = cli.Get("/fast");
+         long elapsed= std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+
+         slow.join();
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(elapsed < 200, Equals(true));
+      });
+
+      it("should continue the chain on the event loop", [&]()
+      {
+         auto res = cli.Get("/chain");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->get_header_value("X-First"), Equals(std::string("offloaded")));
+         AssertThat(res->body, Equals(std::string("chained", 8)));
+      });
+
+      it("should send multiple ranges of a file from an offloaded middleware", [&]()
+      {
+         auto res = cli.Get("/files/testdata1.txt", { { "Range", "bytes=0-3, -4" } });
+
+         AssertThat(res->status, Equals(206));
+         AssertThat(res->get_header_value("Content-Type").find("multipart/byteranges; boundary="), Equals(0));
+         AssertThat(res->body.find("Content-Range: bytes 0-3/19\r\n\r\n<h1>"), Is().Not().EqualTo(std::string::npos));
+         AssertThat(res->body.find("Content-Range: bytes 15-18/19\r\n\r\nh1>\n"), Is().Not().EqualTo(std::string::npos));
+      });
+   });
+});
+
+//***************************************************************************
+// main
+//***************************************************************************
+
+int main(int argc, char* argv[])
+{
+   return bandit::run(argc, argv);
+}
@@ -123,6 +123,410 @@ go_bandit([]()
       });
    });
 
+   //************************************************************************
+   // Compiled router with many routes
+   //************************************************************************
+
+   describe("Compiled router with many routes", []() 
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+
+      cex::Server app;
+      httplib::Client cli(host, port);
+
+      // global middleware registered before the routes must still run first
+
+      app.use([](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         std::string order("global");
+         req->properties.set("order", order);
+         next();
+      });
+
+      for (int i= 0; i < 300; i++)
+      {
+         std::string path= "/route/" + std::to_string(i);
+
+         app.get(path.c_str(), [](cex::Request* req, cex::Response* res, std::function<void()> next)
+         {
+            std::string body= req->properties.getString("order") + " " + req->getMiddlewarePath();
+            res->end(body.c_str(), 200);
+         }, cex::Middleware::fMatchCompare);
+      }
+
+      app.use("/tagged", [](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         std::string order= req->properties.getString("order") + " tagged";
+         req->properties.set("order", order);
+         next();
+      });
+
+      app.get("/contained/", [](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         std::string body= req->properties.getString("order") + " contained";
+         res->end(body.c_str(), 200);
+      });
+
+      app.use([](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         res->end(404);
+      });
+
+      app.listen(host, port, 0 /* don't block */);
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should dispatch exact routes after the global middleware", [&]() 
+      {
+         auto res = cli.Get("/route/123");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals("global /route/123"));
+      });
+
+      it("should not dispatch exact routes for prefixes or other methods", [&]() 
+      {
+         auto res0 = cli.Get("/route/1234");
+         auto res1 = cli.Get("/route/");
+         auto res2 = cli.Post("/route/12", "a=b", "application/x-www-form-urlencoded");
+
+         AssertThat(res0->status, Equals(404));
+         AssertThat(res1->status, Equals(404));
+         AssertThat(res2->status, Equals(404));
+      });
+
+      it("should dispatch contained routes in registration order", [&]() 
+      {
+         auto res0 = cli.Get("/some/tagged/contained/path");
+         auto res1 = cli.Get("/some/contained/path");
+
+         AssertThat(res0->status, Equals(200));
+         AssertThat(res0->body.c_str(), Equals("global tagged contained"));
+         AssertThat(res1->status, Equals(200));
+         AssertThat(res1->body.c_str(), Equals("global contained"));
+      });
+   });
+
+   //************************************************************************
+   // Path parameters
+   //************************************************************************
+
+   describe("Path parameters", []() 
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+
+      cex::Server app;
+      httplib::Client cli(host, port);
+
+      app.get("/users/:id/orders/:oid", [](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         std::string body= req->getParam("id").str() + "/" + req->getParam("oid").str();
+
+         if (!req->getParam("unknown").empty())
+            res->end(500);
+         else
+            res->end(body.c_str(), 200);
+      });
+
+      app.get("/users/me/orders/:oid", [](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         res->end("me", 200);
+      });
+
+      app.get("/users/:name", [](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         std::string body= req->getParam("name").str();
+         res->end(body.c_str(), 200);
+      });
+
+      app.use([](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         res->end(404);
+      });
+
+      app.listen(host, port, 0 /* don't block */);
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should extract all path parameters", [&]() 
+      {
+         auto res = cli.Get("/users/42/orders/4711");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals("42/4711"));
+      });
+
+      it("should run parameterized middlewares in registration order", [&]() 
+      {
+         auto res = cli.Get("/users/me/orders/1");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals("me/1"));
+      });
+
+      it("should match single segments only", [&]() 
+      {
+         auto res0 = cli.Get("/users/john");
+         auto res1 = cli.Get("/users/john/doe");
+         auto res2 = cli.Get("/users//orders/1");
+
+         AssertThat(res0->status, Equals(200));
+         AssertThat(res0->body.c_str(), Equals("john"));
+         AssertThat(res1->status, Equals(404));
+         AssertThat(res2->status, Equals(404));
+      });
+   });
+
+   //************************************************************************
+   // Regular expression routes
+   //************************************************************************
+
+   describe("Regular expression routes", []() 
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+
+      cex::Server app;
+      httplib::Client cli(host, port);
+
+      app.get("^/items/[0-9]+$", [](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         res->end("item", 200);
+      }, cex::Middleware::fMatchRegex);
+
+      app.get("^/(docs|help)/\\w+\\.html$", [](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         res->end("page", 200);
+      }, cex::Middleware::fMatchRegex);
+
+      app.get("^/items/(?=1)", [](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         res->end("lookahead", 200);
+      }, cex::Middleware::fMatchRegex);
+
+      app.use([](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         res->end(404);
+      });
+
+      app.listen(host, port, 0 /* don't block */);
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should dispatch merged regex routes", [&]() 
+      {
+         auto res0 = cli.Get("/items/42");
+         auto res1 = cli.Get("/help/index.html");
+         auto res2 = cli.Get("/items/42/x");
+         auto res3 = cli.Get("/faq/index.html");
+
+         AssertThat(res0->status, Equals(200));
+         AssertThat(res0->body.c_str(), Equals("item"));
+         AssertThat(res1->status, Equals(200));
+         AssertThat(res1->body.c_str(), Equals("page"));
+         AssertThat(res2->status, Equals(404));
+         AssertThat(res3->status, Equals(404));
+      });
+
+      it("should fall back to std::regex for unsupported patterns", [&]() 
+      {
+         auto res = cli.Get("/items/1x");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals("lookahead"));
+      });
+   });
+
+   //************************************************************************
+   // next()
+   //************************************************************************
+
+   describe("Next", []() 
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+
+      cex::Server app;
+      httplib::Client cli(host, port);
+
+      // code after next() runs once the following middlewares are done
+
+      app.get("/order", [](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         std::string log= "1";
+
+         req->properties.set("log", log);
+         next();
+         std::string body= req->properties.getString("log") + "3";
+         res->end(body.c_str(), 200);
+      }, cex::Middleware::fMatchCompare);
+
+      app.get("/order", [](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         std::string log= req->properties.getString("log") + "2";
+
+         req->properties.set("log", log);
+      }, cex::Middleware::fMatchCompare);
+
+      app.get("/fallback", [](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         next();
+
+         if (!res->isDone())
+            res->end(404);
+      }, cex::Middleware::fMatchContain);
+
+      app.get("/fallback/handled", [](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         res->end("handled", 200);
+      }, cex::Middleware::fMatchCompare);
+
+      app.get("/params/:id", [](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         next();
+
+         std::string body= req->getParam("id").str() + "|" + std::to_string(req->getParam("name").size());
+
+         res->end(body.c_str(), 200);
+      }, cex::Middleware::fMatchParams);
+
+      app.listen(host, port, 0 /* don't block */);
+
+      // attached after listen(), so all middlewares are matched one by one (the parameter values grow while
+      // the chain runs)
+
+      for (int i= 0; i < 20; i++)
+      {
+         app.get("/params/:name", [](cex::Request* req, cex::Response* res, cex::Next next)
+         {
+            next();
+         }, cex::Middleware::fMatchParams);
+      }
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should run the following middlewares before next() returns", [&]() 
+      {
+         auto res = cli.Get("/order");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals("123"));
+      });
+
+      it("should keep the parameters of a middleware after next()", [&]() 
+      {
+         auto res = cli.Get("/params/42");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals("42|0"));
+      });
+
+      it("should let a middleware reply if no following middleware did", [&]() 
+      {
+         auto res = cli.Get("/fallback/other");
+
+         AssertThat(res->status, Equals(404));
+
+         res = cli.Get("/fallback/handled");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals("handled"));
+      });
+   });
+
+   //************************************************************************
+   // Middleware chain
+   //************************************************************************
+
+   describe("Middleware chain", []() 
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+
+      cex::Server app;
+      httplib::Client cli(host, port);
+
+      // long chain of middlewares which all continue with next(). must not grow the stack.
+
+      for (int i= 0; i < 50000; i++)
+      {
+         app.use([](cex::Request* req, cex::Response* res, std::function<void()> next)
+         {
+            req->properties.set("count", req->properties.getLong("count") + 1);
+            next();
+         });
+      }
+
+      app.use([](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         std::string body= std::to_string(req->properties.getLong("count"));
+         res->end(body.c_str(), 200);
+      });
+
+      app.listen(host, port, 0 /* don't block */);
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should run all middlewares of a long chain", [&]() 
+      {
+         auto res = cli.Get("/chain");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals("50000"));
+      });
+   });
+
+   //************************************************************************
+   // Multi-reactor mode
+   //************************************************************************
+
+   describe("Multi-reactor mode", []() 
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+
+      cex::Server::Config config;
+      config.reactorCount= 4;
+      config.backlog= 512;
+
+      cex::Server app(config);
+      httplib::Client cli(host, port);
+
+      app.get("/reactor", [](cex::Request* req, cex::Response* res, cex::Next next)
+      {
+         res->end("reactor", 200);
+      }, cex::Middleware::fMatchCompare);
+
+      app.listen(host, port, 0 /* don't block */);
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should reply from any reactor", [&]() 
+      {
+         for (int i= 0; i < 20; i++)
+         {
+            auto res = cli.Get("/reactor");
+
+            AssertThat(res->status, Equals(200));
+            AssertThat(res->body.c_str(), Equals("reactor"));
+         }
+      });
+   });
+
    //************************************************************************
    // Method based routing
    //************************************************************************
@@ -0,0 +1,128 @@
+//*************************************************************************
+// File streaming.cc
+// Date 17.10.2026 - #1
+// Copyright (c) 2018-2026 by Patrick Fial
+//-------------------------------------------------------------------------
+// cex Library streamed responses testcases
+//*************************************************************************
+
+//***************************************************************************
+// includes
+//***************************************************************************
+
+#ifdef CEX_WITH_ZLIB
+#  define CPPHTTPLIB_ZLIB_SUPPORT
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+#include <bandit/bandit.h>
+#include <httplib.h>
+#include <cex.hpp>
+
+using namespace snowhouse;
+using namespace bandit;
+
+//***************************************************************************
+// definitions
+//***************************************************************************
+
+static std::atomic<int> streamsDestroyed(0);
+
+class CountedStream : public std::istringstream
+{
+   public:
+
+      explicit CountedStream(const std::string& str) : std::istringstream(str) {}
+      ~CountedStream() { streamsDestroyed++; }
+};
+
+//***************************************************************************
+// testcase definitions
+//***************************************************************************
+
+go_bandit([]()
+{
+   //************************************************************************
+   // streamed responses testcases
+   //************************************************************************
+
+   describe("Streamed responses", []()
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+      std::string payload;
+
+      // larger than the high watermark, so most of it is sent from the write callback
+
+      for (int i= 0; payload.size() < 8*CEX_STREAM_HIGH_WATERMARK; i++)
+         payload.append("line " + std::to_string(i) + " of the streamed payload\n");
+
+      cex::Server::Config config;
+      config.compressMinBytes= 0;
+
+      cex::Server app(config);
+      httplib::Client cli(host, port);
+
+      app.get("/stream", [&payload](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         res->set("Content-Type", "text/plain");
+         res->stream(201, std::unique_ptr<std::istream>(new CountedStream(payload)));
+      });
+
+      app.listen(host, port, 0 /* don't block */);
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should send the whole stream", [&]()
+      {
+         auto res = cli.Get("/stream");
+
+         AssertThat(res->status, Equals(201));
+         AssertThat(res->has_header("Content-Encoding"), Equals(false));
+         AssertThat(res->body.size(), Equals(payload.size()));
+         AssertThat(res->body == payload, Equals(true));
+      });
+
+      it("should destroy the stream after sending", [&]()
+      {
+         int before= streamsDestroyed;
+         auto res = cli.Get("/stream");
+
+         AssertThat(res->status, Equals(201));
+
+         // the request is finished after the client received the last chunk
+
+         for (int i= 0; i < 100 && streamsDestroyed == before; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+         AssertThat((int)streamsDestroyed, Equals(before+1));
+      });
+
+#ifdef CEX_WITH_ZLIB
+      it("should compress the stream", [&]()
+      {
+         auto res = cli.Get("/stream", { { "Accept-Encoding", "gzip" } });
+
+         AssertThat(res->status, Equals(201));
+         AssertThat(res->get_header_value("Content-Encoding"), Equals(std::string("gzip")));
+         AssertThat(res->body.size(), Equals(payload.size()));
+         AssertThat(res->body == payload, Equals(true));
+      });
+#endif
+   });
+});
+
+//***************************************************************************
+// main
+//***************************************************************************
+
+int main(int argc, char* argv[])
+{
+   return bandit::run(argc, argv);
+}
@@ -10,6 +10,9 @@
 // includes
 //***************************************************************************
 
+#include <chrono>
+#include <thread>
+
 #include <bandit/bandit.h>
 #include <httplib.h>
 #include <cex.hpp>
@@ -19,8 +22,12 @@
 #endif
 
 #include <sys/stat.h> 
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <string.h>
 
 using namespace snowhouse;
 using namespace bandit;
@@ -106,6 +113,196 @@ go_bandit([]()
       });
 #endif
    });
+
+   //************************************************************************
+   // Upload middleware selection
+   //************************************************************************
+
+   describe("Upload middleware selection", []() 
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+      std::string images, documents;
+
+      cex::Server app;
+      httplib::Client cli(host, port);
+
+      app.uploads("/images", [&images](cex::Request* req, const char* data, size_t len) 
+      {
+         images.append(data, len);
+      });
+
+      app.uploads("/documents", [&documents](cex::Request* req, const char* data, size_t len) 
+      {
+         documents.append(data, len);
+      });
+
+      app.post([&images, &documents](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         res->end((std::to_string(images.size()) + "/" + std::to_string(documents.size())).c_str(), 200);
+      });
+
+      app.listen(host, port, 0 /* don't block */);
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should pass all chunks to the matching upload middleware only", [&]() 
+      {
+         std::string contents;
+
+         for (int i= 0; i < 100000; i++)
+            contents += std::to_string(i % 10);
+
+         auto res = cli.Post("/documents/test.txt", contents, "text/plain");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals("0/100000"));
+         AssertThat(documents == contents, Equals(true));
+      });
+   });
+
+   //************************************************************************
+   // Zero-copy request body
+   //************************************************************************
+
+   describe("Zero-copy request body", []() 
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+
+      cex::Server::Config config;
+      config.zeroCopyBody= true;
+
+      cex::Server app(config);
+      httplib::Client cli(host, port);
+
+      app.post("/body", [](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         // chunks (no copy) and joined body must have the same contents
+
+         std::string joined;
+         const std::vector<cex::StringView>& chunks= req->bodyChunks();
+
+         for (size_t i= 0; i < chunks.size(); i++)
+            joined.append(chunks[i].data(), chunks[i].size());
+
+         std::string body(req->getBody(), req->getBodyLength());
+
+         if (joined != body || req->bodyChunks().size() != 1)
+            res->end(500);
+         else
+            res->end(body.c_str(), 200);
+      });
+
+      app.listen(host, port, 0 /* don't block */);
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should provide the body as chunks and as joined buffer", [&]() 
+      {
+         std::string contents(200000, 'x');
+         auto res = cli.Post("/body", contents, "text/plain");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals(contents));
+      });
+   });
+
+   //************************************************************************
+   // Maximum body size
+   //************************************************************************
+
+   describe("Maximum body size", []() 
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+
+      cex::Server::Config config;
+      config.maxBodySize= 1000;
+
+      cex::Server app(config);
+      httplib::Client cli(host, port);
+
+      app.post("/body", [](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         res->end(std::to_string(req->getBodyLength()).c_str(), 200);
+      });
+
+      app.listen(host, port, 0 /* don't block */);
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should accept a body up to the limit", [&]() 
+      {
+         std::string contents(1000, 'x');
+         auto res = cli.Post("/body", contents, "text/plain");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals("1000"));
+      });
+
+      it("should return 413 for a body exceeding the limit", [&]() 
+      {
+         std::string contents(200000, 'x');
+         auto res = cli.Post("/body", contents, "text/plain");
+
+         AssertThat(res->status, Equals(413));
+      });
+   });
+
+   //************************************************************************
+   // Announced body size without limit
+   //************************************************************************
+
+   describe("Announced body size without limit", []() 
+   {
+      int port= 15555;
+      const char* host= "127.0.0.1";
+
+      cex::Server app;
+      httplib::Client cli(host, port);
+
+      app.post("/body", [](cex::Request* req, cex::Response* res, std::function<void()> next)
+      {
+         res->end(std::to_string(req->getBodyLength()).c_str(), 200);
+      });
+
+      app.listen(host, port, 0 /* don't block */);
+
+      //*********************************************************************
+      // testcases
+      //*********************************************************************
+
+      it("should survive a forged huge Content-Length", [&]() 
+      {
+         const char* request= "POST /body HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: 99999999999999\r\n\r\n0123456789";
+         struct sockaddr_in addr;
+
+         memset(&addr, 0, sizeof(addr));
+         addr.sin_family= AF_INET;
+         addr.sin_port= htons(port);
+         inet_pton(AF_INET, host, &addr.sin_addr);
+
+         int fd= socket(AF_INET, SOCK_STREAM, 0);
+
+         AssertThat(connect(fd, (struct sockaddr*)&addr, sizeof(addr)), Equals(0));
+         AssertThat(write(fd, request, strlen(request)), Equals((ssize_t)strlen(request)));
+
+         std::this_thread::sleep_for(std::chrono::milliseconds(100));
+         close(fd);
+
+         auto res = cli.Post("/body", std::string(100, 'x'), "text/plain");
+
+         AssertThat(res->status, Equals(200));
+         AssertThat(res->body.c_str(), Equals("100"));
+      });
+   });
 });
 
 //***************************************************************************